@@ -0,0 +1,76 @@
+#include "btree_rope.hpp"
+#include "byte_scan.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+// Compares the dispatched byte scanning kernels against plain scalar loops
+// over a buffer much larger than the last level cache, and against the same
+// scan over a BTreeRope's leaves.
+
+static const int BUFFER_SIZE = 256 * 1024 * 1024;
+static const int ITERATIONS = 5;
+
+template <typename Fn>
+static void measure(const char* name, const std::string& buffer, Fn fn)
+{
+    int result = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < ITERATIONS; i++)
+        result += fn(buffer.data(), buffer.length());
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double gigabytes = double(buffer.length()) * ITERATIONS / 1e9;
+
+    std::cout << "  " << name << ": " << gigabytes / elapsed.count() << " GB/s"
+              << " (result " << result / ITERATIONS << ")" << std::endl;
+}
+
+int main()
+{
+    std::string buffer(BUFFER_SIZE, 'x');
+
+    for (int i = 0; i < BUFFER_SIZE; i += 61)
+        buffer[i] = '\n';
+
+    buffer[BUFFER_SIZE - 1] = '#';
+
+    std::cout << "Kernels: " << byteScanImplementation() << std::endl;
+
+    std::cout << "countByte" << std::endl;
+    measure("scalar", buffer, [](const char* data, int length)
+    {
+        int count = 0;
+        for (int i = 0; i < length; i++)
+            count += data[i] == '\n';
+        return count;
+    });
+    measure("kernel", buffer, [](const char* data, int length) { return countByte(data, length, '\n'); });
+
+    BTreeRope rope(buffer);
+    measure("BTreeRope::count", buffer, [&](const char*, int) { return rope.count('\n'); });
+
+    std::cout << "findByte" << std::endl;
+    measure("scalar", buffer, [](const char* data, int length)
+    {
+        for (int i = 0; i < length; i++)
+            if (data[i] == '#')
+                return i;
+        return -1;
+    });
+    measure("kernel", buffer, [](const char* data, int length) { return findByte(data, length, '#'); });
+
+    std::cout << "countUtf8LeadBytes" << std::endl;
+    measure("scalar", buffer, [](const char* data, int length)
+    {
+        int count = 0;
+        for (int i = 0; i < length; i++)
+            count += (data[i] & 0xC0) != 0x80;
+        return count;
+    });
+    measure("kernel", buffer, countUtf8LeadBytes);
+
+    return 0;
+}
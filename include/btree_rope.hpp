@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct BTreeNode;
+using BTreeNodePtr = std::shared_ptr<BTreeNode>;
+
+// The text and structure of a node never change once it is reachable from a
+// rope, so subtrees can be shared freely between ropes and between versions of
+// the same rope. Leaves do have mutable state, see BTreeLeaf.
+struct BTreeNode
+{
+    int height = 0;
+    int length = 0;
+
+    bool isLeaf() const { return height == 0; }
+};
+
+// A cold leaf may be compressed in place: content is released and packed holds
+// the compressed bytes, until a later sweep finds it read again and restores
+// it. This changes only the representation, not the text, so it is allowed on
+// shared leaves. It is not synchronized, though, and reads through a rope with
+// compression enabled mark leaves as accessed: once any rope enables it, all
+// ropes sharing its leaves must be used from a single thread.
+struct BTreeLeaf : BTreeNode
+{
+    mutable std::string content;
+    mutable std::string packed;
+    mutable bool accessed = true;
+
+    bool isCompressed() const { return !packed.empty(); }
+};
+
+struct BTreeBranch : BTreeNode
+{
+    static const int MAX_CHILDREN = 16;
+    static const int MIN_CHILDREN = MAX_CHILDREN / 2;
+
+    int count = 0;
+
+    // Cumulative end offset of each child. Unused slots hold INT_MAX so that a
+    // descent can scan the whole (single cache line) array without a bound check.
+    std::array<int, MAX_CHILDREN> offsets;
+    std::array<BTreeNodePtr, MAX_CHILDREN> children;
+
+    BTreeBranch() { offsets.fill(INT_MAX); }
+
+    int childIndex(int index) const;
+    int childStart(int i) const { return i == 0 ? 0 : offsets[i - 1]; }
+};
+
+// Rope variant backed by a high-fanout B-tree. Internal nodes hold up to
+// MAX_CHILDREN children, so a lookup only touches log16(n) nodes instead of
+// the log2(n) scattered nodes of the binary Rope.
+class BTreeRope
+{
+    static const int MAX_LEAF = 1024;
+    static const int MIN_LEAF = MAX_LEAF / 2;
+    static const int DECOMPRESSED_CACHE_SIZE = 8;
+
+    BTreeNodePtr root;
+    bool compression = false;
+
+    // Recently decompressed leaves, most recent first.
+    mutable std::list<std::pair<BTreeNodePtr, std::string>> decompressed;
+
+public:
+    BTreeRope() = default;
+    BTreeRope(const std::string& str);
+    BTreeRope(const char* str);
+    BTreeRope(char c);
+
+    bool operator==(const BTreeRope& other) const;
+
+    std::pair<BTreeRope, BTreeRope> split(int index) const;
+    void concat(const BTreeRope& other);
+    void insert(const BTreeRope& other, int index);
+    char at(int index) const;
+    BTreeRope subString(int start, int end) const;
+    void erase(int start, int end);
+    void rebalance();
+    int length() const;
+
+    // Leaves are large enough for the byte_scan kernels to run their vector
+    // loops, so these scan at close to memory bandwidth.
+    int count(char c) const;
+    int find(char c, int start = 0) const;
+
+    // Reads only track leaf accesses once compression is enabled; until then
+    // they make no writes and ropes may be read from several threads.
+    void enableCompression() { compression = true; }
+
+    // Compresses every leaf that has not been read since the previous call,
+    // and returns the number of leaves compressed. Compressed leaves that were
+    // read since the previous call are decompressed again. Does nothing unless
+    // compression is enabled.
+    int compressColdLeaves();
+    size_t leafBytes() const;
+
+    BTreeNodePtr rootNode() const { return root; }
+    std::string asString() const;
+    void print() const;
+
+private:
+    static BTreeNodePtr makeLeaf(std::string content);
+    static BTreeNodePtr makeBranch(const BTreeNodePtr* children, int count);
+    static BTreeNodePtr fromChildren(const std::vector<BTreeNodePtr>& children);
+    static BTreeNodePtr buildTree(std::vector<BTreeNodePtr> nodes);
+
+    static BTreeNodePtr join(const BTreeNodePtr& left, const BTreeNodePtr& right);
+    static BTreeNodePtr joinLeaves(const BTreeNodePtr& left, const BTreeNodePtr& right);
+    static BTreeNodePtr slice(const BTreeNodePtr& node, int start, int end);
+    static bool isBalanced(const BTreeNodePtr& node);
+
+    std::vector<BTreeNodePtr> collectLeaves() const;
+    const std::string& leafContent(const BTreeNodePtr& leaf, std::string& scratch) const;
+    void restoreLeaf(const BTreeNodePtr& leaf);
+
+    void printBranches(const BTreeNodePtr& node, const std::string& prefix = "", bool isLeft = false) const;
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+// Byte scanning kernels used on leaf content. Each call dispatches at runtime
+// to an AVX2 or SSE2 implementation when the CPU supports it, and otherwise to
+// a scalar loop.
+
+int countByte(const char* data, int length, char byte);
+int findByte(const char* data, int length, char byte);
+int findLastByte(const char* data, int length, char byte);
+int countUtf8LeadBytes(const char* data, int length);
+
+const char* byteScanImplementation();
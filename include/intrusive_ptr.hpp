@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+#if __has_include(<sys/single_threaded.h>)
+#include <sys/single_threaded.h>
+#define INTRUSIVE_PTR_SINGLE_THREADED_CHECK
+#endif
+
+// Reference count policies for IntrusivePtr targets. Copying an object does not
+// copy its count, since the copy starts out unreferenced.
+
+struct AtomicRefCount
+{
+    std::atomic<int> count{0};
+
+    AtomicRefCount() = default;
+    AtomicRefCount(const AtomicRefCount&) {}
+    AtomicRefCount& operator=(const AtomicRefCount&) { return *this; }
+
+    void increment()
+    {
+        if (singleThreaded())
+            count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        else
+            count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool decrement()
+    {
+        if (singleThreaded())
+        {
+            int value = count.load(std::memory_order_relaxed) - 1;
+            count.store(value, std::memory_order_relaxed);
+            return value == 0;
+        }
+
+        return count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
+    int load() const { return count.load(std::memory_order_acquire); }
+
+private:
+    // Like libstdc++'s shared_ptr, skip the locked instructions while the
+    // process has never started a second thread.
+    static bool singleThreaded()
+    {
+#ifdef INTRUSIVE_PTR_SINGLE_THREADED_CHECK
+        return __libc_single_threaded;
+#else
+        return false;
+#endif
+    }
+};
+
+// For objects that are only ever referenced from a single thread.
+struct PlainRefCount
+{
+    int count = 0;
+
+    PlainRefCount() = default;
+    PlainRefCount(const PlainRefCount&) {}
+    PlainRefCount& operator=(const PlainRefCount&) { return *this; }
+
+    void increment() { count++; }
+    bool decrement() { return --count == 0; }
+    int load() const { return count; }
+};
+
+// Owning handle to an object that carries its own reference count in a member
+// named refCount, so there is no separate control block.
+template <typename T>
+class IntrusivePtr
+{
+    T* ptr = nullptr;
+
+public:
+    IntrusivePtr() = default;
+    IntrusivePtr(std::nullptr_t) {}
+
+    explicit IntrusivePtr(T* object)
+        : ptr(object)
+    {
+        if (ptr != nullptr)
+            ptr->refCount.increment();
+    }
+
+    IntrusivePtr(const IntrusivePtr& other)
+        : IntrusivePtr(other.ptr)
+    {}
+
+    IntrusivePtr(IntrusivePtr&& other) noexcept
+        : ptr(std::exchange(other.ptr, nullptr))
+    {}
+
+    ~IntrusivePtr() { reset(); }
+
+    IntrusivePtr& operator=(const IntrusivePtr& other)
+    {
+        IntrusivePtr(other).swap(*this);
+        return *this;
+    }
+
+    IntrusivePtr& operator=(IntrusivePtr&& other) noexcept
+    {
+        IntrusivePtr(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    void reset()
+    {
+        if (ptr != nullptr && ptr->refCount.decrement())
+            delete ptr;
+
+        ptr = nullptr;
+    }
+
+    void swap(IntrusivePtr& other) noexcept { std::swap(ptr, other.ptr); }
+
+    T* get() const { return ptr; }
+    T& operator*() const { return *ptr; }
+    T* operator->() const { return ptr; }
+    explicit operator bool() const { return ptr != nullptr; }
+
+    int useCount() const { return ptr == nullptr ? 0 : ptr->refCount.load(); }
+    bool unique() const { return useCount() == 1; }
+
+    friend bool operator==(const IntrusivePtr& a, const IntrusivePtr& b) { return a.ptr == b.ptr; }
+    friend bool operator!=(const IntrusivePtr& a, const IntrusivePtr& b) { return a.ptr != b.ptr; }
+    friend bool operator==(const IntrusivePtr& a, std::nullptr_t) { return a.ptr == nullptr; }
+    friend bool operator!=(const IntrusivePtr& a, std::nullptr_t) { return a.ptr != nullptr; }
+    friend bool operator==(std::nullptr_t, const IntrusivePtr& b) { return b.ptr == nullptr; }
+    friend bool operator!=(std::nullptr_t, const IntrusivePtr& b) { return b.ptr != nullptr; }
+};
+
+template <typename T, typename... Args>
+IntrusivePtr<T> makeIntrusive(Args&&... args)
+{
+    return IntrusivePtr<T>(new T(std::forward<Args>(args)...));
+}
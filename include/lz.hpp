@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+
+// Small LZ77-style codec for leaf content. The stream is a sequence of tokens:
+// a control byte below 0x80 starts a run of (byte + 1) literals, anything else
+// is a match of ((byte & 0x7F) + 4) bytes followed by a 16-bit little-endian
+// distance back into the output.
+
+std::string lzCompress(const std::string& input);
+std::string lzDecompress(const std::string& input, int length);
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "rope.hpp"
+
+#include <string>
+#include <vector>
+
+// Aho-Corasick automaton over a fixed set of byte patterns. A scan makes one
+// pass over the rope's leaf chunks no matter how many patterns there are, and
+// the automaton state carries over between chunks and between calls.
+class PatternMatcher
+{
+public:
+    struct Match
+    {
+        int pattern;
+        int offset;
+
+        bool operator==(const Match& other) const { return pattern == other.pattern && offset == other.offset; }
+    };
+
+    // Position of a scan in progress. A default state starts at offset 0.
+    struct State
+    {
+        int node = 0;
+        int offset = 0;
+    };
+
+    // Empty patterns never match.
+    PatternMatcher(const std::vector<std::string>& patterns);
+
+    // Reports every match lying entirely within [start, end) of the rope.
+    template <typename RefCount>
+    std::vector<Match> scan(const BasicRope<RefCount>& rope, int start = 0, int end = -1) const;
+
+    // Continues a scan from state up to end, leaving state at end. After an
+    // edit at some offset, a scan can be restarted maxPatternLength() - 1
+    // bytes before it with a fresh state.
+    template <typename RefCount>
+    void scan(const BasicRope<RefCount>& rope, State& state, int end, std::vector<Match>& matches) const;
+
+    // Feeds the bytes following state.offset to the automaton.
+    void feed(State& state, const char* data, int length, std::vector<Match>& matches) const;
+
+    int maxPatternLength() const { return maxLength; }
+
+private:
+    int addNode();
+
+    // Bytes that occur in no pattern share class 0, which keeps rows short.
+    unsigned char byteClass[256] = {};
+    int classCount = 1;
+
+    std::vector<int> transitions;
+    std::vector<std::vector<int>> outputs;
+    std::vector<int> outputLinks;
+    std::vector<char> hasOutput;
+
+    std::vector<int> lengths;
+    int maxLength = 0;
+};
@@ -1,56 +1,265 @@
-#include <memory>
+#pragma once
+
+#include "intrusive_ptr.hpp"
+
+#include <functional>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
-struct RopeNode;
-using RopeNodePtr = std::shared_ptr<RopeNode>;
+template <typename RefCount>
+struct BasicRopeNode;
+
+template <typename RefCount>
+class BasicRopePool;
 
-struct RopeNode
+template <typename RefCount>
+using BasicRopeNodePtr = IntrusivePtr<BasicRopeNode<RefCount>>;
+
+template <typename RefCount>
+struct BasicRopeNode
 {
+    RefCount refCount;
     int weight;
-    RopeNodePtr lChild;
-    RopeNodePtr rChild;
+    int newlines;
+    BasicRopeNodePtr<RefCount> lChild;
+    BasicRopeNodePtr<RefCount> rChild;
     std::string content;
 
-    bool isLeaf() { return lChild == nullptr && rChild == nullptr; }
+    bool isLeaf() const { return lChild == nullptr && rChild == nullptr; }
 };
 
-class Rope
+static_assert(sizeof(BasicRopeNode<AtomicRefCount>) <= 64, "RopeNode should fit in a cache line");
+static_assert(sizeof(BasicRopeNode<PlainRefCount>) <= 64, "RopeNode should fit in a cache line");
+
+using RopeNode = BasicRopeNode<AtomicRefCount>;
+using RopeNodePtr = BasicRopeNodePtr<AtomicRefCount>;
+
+// A single edit: removed bytes at offset were replaced by inserted bytes.
+struct RopeDelta
 {
+    int offset;
+    int removed;
+    int inserted;
+
+    bool operator==(const RopeDelta& other) const
+    {
+        return offset == other.offset && removed == other.removed && inserted == other.inserted;
+    }
+
+    // Maps a position in the text before the edit to the text after it. A
+    // position at an insertion point stays before the inserted text unless
+    // afterInsert is set.
+    int transform(int position, bool afterInsert = false) const;
+    static int transform(int position, const std::vector<RopeDelta>& deltas, bool afterInsert = false);
+
+    // Folds the following edit into this one if their ranges touch.
+    bool merge(const RopeDelta& next);
+};
+
+// RefCount is the node reference count policy, see intrusive_ptr.hpp. Nodes
+// are shared between copies of a rope, so every rope sharing a node has to
+// use the same policy.
+template <typename RefCount>
+class BasicRope
+{
+public:
+    using Node = BasicRopeNode<RefCount>;
+    using NodePtr = BasicRopeNodePtr<RefCount>;
+
+private:
     static const int MAX_WEIGHT = 5;
-    RopeNodePtr root;
+    static const int MAX_LEAF_GROWTH = 4 * MAX_WEIGHT;
+
+    // Path from the root to the most recently edited leaf, so that reads and
+    // small edits next to the previous edit skip the descent from the root.
+    // Only edits move it, which keeps const reads free of side effects and
+    // safe to run concurrently.
+    struct Finger
+    {
+        const Node* root = nullptr;
+        std::vector<Node*> path;
+        int start = 0;
+    };
+
+    NodePtr root;
+    Finger finger;
+
+    // Observers and the delta log belong to one rope object, so copies of the
+    // rope start without them.
+    struct EditLog
+    {
+        bool logging = false;
+        std::vector<RopeDelta> deltas;
+        std::vector<std::pair<int, std::function<void(const RopeDelta&)>>> observers;
+        int nextObserverId = 0;
+
+        EditLog() = default;
+        EditLog(const EditLog&) {}
+        EditLog& operator=(const EditLog&) { return *this; }
+    };
+
+    EditLog edits;
+
+    // The file last saved to and the sorted, disjoint byte ranges changed
+    // since. Only this rope object knows what that file holds, so copies start
+    // with nothing saved, while a move takes the state along with the content.
+    struct SavedFile
+    {
+        std::string path;
+        std::vector<std::pair<int, int>> dirty;
+
+        // The file as it was right after the save. If it has since been
+        // deleted, replaced or modified, only a full save is safe.
+        unsigned long long device = 0;
+        unsigned long long inode = 0;
+        long long size = -1;
+        long long modified = 0;
+
+        SavedFile() = default;
+        SavedFile(const SavedFile&) {}
+        SavedFile(SavedFile&&) = default;
+        SavedFile& operator=(const SavedFile&) { return *this = SavedFile(); }
+        SavedFile& operator=(SavedFile&&) = default;
+    };
+
+    SavedFile saved;
 
 public:
-    Rope() = default;
-    Rope(const std::string& str);
-    Rope(const char* str);
-    Rope(char c);
+    BasicRope() = default;
+    BasicRope(const std::string& str);
+    BasicRope(const char* str);
+    BasicRope(char c);
 
-    bool operator==(const Rope& other) const;
+    // Comparisons are by content, walking both ropes' leaves in lockstep
+    // without flattening either. compare returns <0, 0 or >0.
+    bool operator==(const BasicRope& other) const;
+    bool operator!=(const BasicRope& other) const;
+    bool operator<(const BasicRope& other) const;
+    bool operator<=(const BasicRope& other) const;
+    bool operator>(const BasicRope& other) const;
+    bool operator>=(const BasicRope& other) const;
+    int compare(const BasicRope& other) const;
+    int commonPrefixLength(const BasicRope& other) const;
+    bool startsWith(const BasicRope& prefix) const;
+    bool endsWith(const BasicRope& suffix) const;
 
-    std::pair<Rope, Rope> split(int index) const;
-    void concat(const Rope& other);
-    void insert(const Rope& other, int index);
+    // True if both ropes have the same tree shape and leaves.
+    bool sameStructure(const BasicRope& other) const;
+
+    std::pair<BasicRope, BasicRope> split(int index) const&;
+    std::pair<BasicRope, BasicRope> split(int index) &&;
+    void concat(const BasicRope& other);
+    void concat(BasicRope&& other);
+    void insert(const BasicRope& other, int index);
+    void insert(BasicRope&& other, int index);
     char at(int index) const;
-    Rope subString(int start, int end) const;
+    BasicRope subString(int start, int end) const;
     void erase(int start, int end);
     void rebalance();
     int length() const;
 
-    RopeNodePtr rootNode() const { return root; }
+    void append(std::string_view str);
+    void append(std::string&& str);
+    void append(const char* str);
+    void prepend(std::string_view str);
+    void prepend(std::string&& str);
+    void prepend(const char* str);
+
+    int count(char c) const;
+    int find(char c, int start = 0) const;
+    int findLast(char c) const;
+    int newlineCount() const;
+    int utf8Length() const;
+
+    // Calls visit(data, length, offset) for each leaf chunk overlapping
+    // [start, end), in order, until visit returns false.
+    using ChunkVisitor = std::function<bool(const char*, int, int)>;
+    void forEachChunk(int start, int end, const ChunkVisitor& visit) const;
+
+    using EditObserver = std::function<void(const RopeDelta&)>;
+
+    // Observers are called with every edit as it happens. The delta log, if
+    // enabled, collects edits with adjacent ones merged until taken.
+    int addObserver(EditObserver observer);
+    void removeObserver(int id);
+    void setDeltaLogging(bool enabled);
+    std::vector<RopeDelta> takeDeltas();
+
+    // Writes the rope to path. If path was the last save target and the file
+    // is unchanged since, only the ranges changed since then are rewritten.
+    void save(const std::string& path);
+    void markSaved(const std::string& path);
+    const std::vector<std::pair<int, int>>& dirtyRanges() const { return saved.dirty; }
+
+    // Replaces the rope's nodes with the pool's shared copies of equal nodes.
+    void intern(BasicRopePool<RefCount>& pool);
+
+    NodePtr rootNode() const { return root; }
     std::string asString() const;
     void print() const;
 
 private:
-    RopeNodePtr buildTree(std::vector<RopeNodePtr>& leaves);
-    RopeNodePtr copySubtree(RopeNodePtr node);
-    std::vector<RopeNodePtr> collectLeaves() const;
+    // Position in a rope's sequence of leaf chunks.
+    struct ChunkCursor
+    {
+        std::vector<const Node*> pending;
+        const char* data = nullptr;
+        int size = 0;
+
+        ChunkCursor(const Node* root, int start);
+
+        bool done() const { return size == 0; }
+        void advance(int count);
+        void nextLeaf();
+    };
+
+    // Compares up to length bytes from both cursors. Returns the number of equal
+    // bytes before the first difference and sets order to its sign, or to 0.
+    static int compareChunks(ChunkCursor& a, ChunkCursor& b, int length, int& order);
+
+    static BasicRope fromText(std::string_view str);
+    static BasicRope fromText(std::string&& str);
+    static NodePtr makeLeaf(std::string content);
+    static NodePtr makeLeaf(std::string content, int newlines);
+    static std::pair<NodePtr, NodePtr> splitNode(NodePtr node, int index, bool steal);
+
+    NodePtr buildTree(std::string_view str);
+    NodePtr buildTree(std::vector<NodePtr>& leaves);
+    NodePtr copySubtree(NodePtr node);
+    std::vector<NodePtr> collectLeaves() const;
+    static void collectLeaves(const NodePtr& node, std::vector<NodePtr>& leaves);
     void copyOnWrite();
 
-    std::string nodeAsString(RopeNodePtr node) const;
-    int nodeDepth(const RopeNodePtr node) const;
-    int nodeLength(const RopeNodePtr node) const;
+    bool fingerCovers(int index, bool inclusiveEnd) const;
+    Node* seekLeaf(int index, bool preferLeft);
+    bool fingerPathUnique() const;
+    bool insertAtFinger(const std::string& str, int index);
+    int eraseAtFinger(int start, int end);
+    void mergeFingerLeaf();
+    void splitFingerLeaf(int cursor);
+    void rebuildFingerPath();
+    static int maxDepth(int length);
+    void invalidateFinger() { finger = Finger(); }
 
-    void printBranches(const RopeNodePtr node, const std::string& prefix = "", bool isLeft = false) const;
+    void recordEdit(const RopeDelta& delta);
+    void markDirty(int start, int end);
+
+    static int nodeNewlines(const NodePtr& node);
+    static int contentNewlines(const std::string& content);
+
+    std::string nodeAsString(NodePtr node) const;
+    int nodeDepth(const NodePtr node) const;
+    int nodeLength(const NodePtr node) const;
+
+    void printBranches(const NodePtr node, const std::string& prefix = "", bool isLeft = false) const;
 };
+
+// Rope uses atomic counts, so copies can be handed to other threads. LocalRope
+// uses plain counts and is for ropes whose nodes never leave one thread.
+using Rope = BasicRope<AtomicRefCount>;
+using LocalRope = BasicRope<PlainRefCount>;
+
+extern template class BasicRope<AtomicRefCount>;
+extern template class BasicRope<PlainRefCount>;
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "rope.hpp"
+
+#include <cstddef>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+// Intern table for rope nodes. Leaves with equal content, and branches with
+// equal (interned) children, are replaced by a single shared node. Shared nodes
+// are never modified in place, so ropes stay independently editable.
+template <typename RefCount>
+class BasicRopePool
+{
+public:
+    using Node = BasicRopeNode<RefCount>;
+    using NodePtr = BasicRopeNodePtr<RefCount>;
+
+    struct Stats
+    {
+        size_t uniqueLeaves = 0;
+        size_t uniqueBranches = 0;
+
+        // Storage the current references to pooled nodes would need if every
+        // one of them had its own copy of the node and its subtree, beyond the
+        // single copy in the pool.
+        size_t bytesSaved = 0;
+    };
+
+    // Shared by the whole process, except for plain counts, which cannot be
+    // shared between threads: each thread then has its own pool.
+    static BasicRopePool& global();
+
+    NodePtr intern(const NodePtr& node);
+
+    // Drops pooled nodes that no rope refers to anymore.
+    void purge();
+
+    Stats stats() const;
+
+private:
+    struct BranchKey
+    {
+        const Node* lChild;
+        const Node* rChild;
+        int weight;
+
+        bool operator==(const BranchKey& other) const
+        {
+            return lChild == other.lChild && rChild == other.rChild && weight == other.weight;
+        }
+    };
+
+    struct BranchKeyHash
+    {
+        size_t operator()(const BranchKey& key) const;
+    };
+
+    NodePtr internNode(const NodePtr& node);
+    size_t countBytesSaved() const;
+
+    // Keys view the content of the pooled leaf itself.
+    std::unordered_map<std::string_view, NodePtr> leaves;
+    std::unordered_map<BranchKey, NodePtr, BranchKeyHash> branches;
+
+    mutable std::mutex mutex;
+};
+
+using RopePool = BasicRopePool<AtomicRefCount>;
+using LocalRopePool = BasicRopePool<PlainRefCount>;
+
+extern template class BasicRopePool<AtomicRefCount>;
+extern template class BasicRopePool<PlainRefCount>;
@@ -0,0 +1,584 @@
+#include "btree_rope.hpp"
+#include "byte_scan.hpp"
+#include "lz.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+static const BTreeLeaf* asLeaf(const BTreeNodePtr& node)
+{
+    return static_cast<const BTreeLeaf*>(node.get());
+}
+
+static const BTreeBranch* asBranch(const BTreeNodePtr& node)
+{
+    return static_cast<const BTreeBranch*>(node.get());
+}
+
+// Text of a leaf for structural operations, decompressed into scratch if needed.
+static const std::string& unpacked(const BTreeLeaf* leaf, std::string& scratch)
+{
+    if (!leaf->isCompressed())
+        return leaf->content;
+
+    scratch = lzDecompress(leaf->packed, leaf->length);
+    return scratch;
+}
+
+int BTreeBranch::childIndex(int index) const
+{
+    // Branchless count over the full offset array; unused slots are INT_MAX and
+    // never counted. Fixed trip count lets the compiler vectorize the scan.
+    int i = 0;
+
+    for (int k = 0; k < MAX_CHILDREN; k++)
+        i += offsets[k] <= index;
+
+    return std::min(i, count - 1);
+}
+
+BTreeRope::BTreeRope(const std::string& str)
+{
+    if (str.empty())
+        return;
+
+    // Spread the content evenly so that no leaf falls below MIN_LEAF.
+    int leafCount = (str.length() + MAX_LEAF - 1) / MAX_LEAF;
+    int leafSize = str.length() / leafCount;
+    int remainder = str.length() % leafCount;
+
+    auto leaves = std::vector<BTreeNodePtr>();
+    leaves.reserve(leafCount);
+
+    int start = 0;
+
+    for (int i = 0; i < leafCount; i++)
+    {
+        int size = leafSize + (i < remainder ? 1 : 0);
+
+        leaves.push_back(makeLeaf(str.substr(start, size)));
+        start += size;
+    }
+
+    root = buildTree(std::move(leaves));
+}
+
+BTreeRope::BTreeRope(const char* str)
+    : BTreeRope(std::string(str))
+{}
+
+BTreeRope::BTreeRope(char c)
+    : BTreeRope(std::string(1, c))
+{}
+
+bool BTreeRope::operator==(const BTreeRope& other) const
+{
+    return length() == other.length() && asString() == other.asString();
+}
+
+std::string BTreeRope::asString() const
+{
+    std::string result;
+    result.reserve(length());
+
+    // Decompress into scratch rather than through the cache to keep hot leaves cached.
+    std::string scratch;
+
+    for (const auto& leaf : collectLeaves())
+        result += unpacked(asLeaf(leaf), scratch);
+
+    return result;
+}
+
+void BTreeRope::print() const
+{
+    std::cout << "BTree Rope" << std::endl;
+
+    printBranches(root);
+}
+
+std::pair<BTreeRope, BTreeRope> BTreeRope::split(int index) const
+{
+    if (root == nullptr)
+        return {BTreeRope(), BTreeRope()};
+
+    if (index < 0 || index > length())
+        return {BTreeRope(), BTreeRope()};
+
+    BTreeRope leftRope, rightRope;
+
+    leftRope.root = slice(root, 0, index);
+    rightRope.root = slice(root, index, length());
+
+    return {leftRope, rightRope};
+}
+
+void BTreeRope::concat(const BTreeRope& other)
+{
+    root = join(root, other.root);
+}
+
+void BTreeRope::insert(const BTreeRope& other, int index)
+{
+    if (index < 0 || index > length())
+        throw std::out_of_range("Index out of range");
+
+    auto left = slice(root, 0, index);
+    auto right = slice(root, index, length());
+
+    root = join(join(left, other.root), right);
+}
+
+char BTreeRope::at(int index) const
+{
+    if (index < 0 || index >= length())
+        return '\0';
+
+    const BTreeNodePtr* node = &root;
+
+    while (!(*node)->isLeaf())
+    {
+        auto branch = asBranch(*node);
+        int i = branch->childIndex(index);
+
+        index -= branch->childStart(i);
+        node = &branch->children[i];
+    }
+
+    std::string scratch;
+    return leafContent(*node, scratch)[index];
+}
+
+BTreeRope BTreeRope::subString(int start, int end) const
+{
+    if (start < 0 || start > length() || end < 0 || end > length())
+        throw std::out_of_range("Index out of range");
+
+    if (start >= end)
+        return BTreeRope();
+
+    BTreeRope result;
+    result.root = slice(root, start, end);
+
+    return result;
+}
+
+void BTreeRope::erase(int start, int end)
+{
+    if (start < 0 || start > length() || end < 0 || end > length())
+        throw std::out_of_range("Index out of range");
+
+    if (start >= end)
+        return;
+
+    root = join(slice(root, 0, start), slice(root, end, length()));
+}
+
+void BTreeRope::rebalance()
+{
+    root = buildTree(collectLeaves());
+}
+
+int BTreeRope::length() const
+{
+    return root == nullptr ? 0 : root->length;
+}
+
+int BTreeRope::count(char c) const
+{
+    int result = 0;
+    std::string scratch;
+
+    for (const auto& leaf : collectLeaves())
+    {
+        const std::string& content = unpacked(asLeaf(leaf), scratch);
+        result += countByte(content.data(), content.length(), c);
+    }
+
+    return result;
+}
+
+int BTreeRope::find(char c, int start) const
+{
+    int offset = 0;
+    std::string scratch;
+
+    start = std::max(start, 0);
+
+    for (const auto& leaf : collectLeaves())
+    {
+        if (offset + leaf->length > start)
+        {
+            const std::string& content = unpacked(asLeaf(leaf), scratch);
+
+            int from = std::max(start - offset, 0);
+            int index = findByte(content.data() + from, content.length() - from, c);
+
+            if (index >= 0)
+                return offset + from + index;
+        }
+
+        offset += leaf->length;
+    }
+
+    return -1;
+}
+
+int BTreeRope::compressColdLeaves()
+{
+    int compressed = 0;
+
+    if (!compression)
+        return compressed;
+
+    for (const auto& node : collectLeaves())
+    {
+        auto leaf = asLeaf(node);
+
+        if (leaf->accessed)
+        {
+            // A compressed leaf read since the last sweep is warm again, so
+            // restore it rather than decompressing it on every read.
+            if (leaf->isCompressed())
+                restoreLeaf(node);
+
+            leaf->accessed = false;
+            continue;
+        }
+
+        if (leaf->isCompressed())
+            continue;
+
+        std::string packed = lzCompress(leaf->content);
+
+        if (packed.length() >= leaf->content.length())
+            continue;
+
+        leaf->packed = std::move(packed);
+        leaf->content = std::string();
+        compressed++;
+    }
+
+    return compressed;
+}
+
+void BTreeRope::restoreLeaf(const BTreeNodePtr& node)
+{
+    auto leaf = asLeaf(node);
+
+    auto cached = std::find_if(decompressed.begin(), decompressed.end(), [&](const auto& entry) { return entry.first == node; });
+
+    if (cached != decompressed.end())
+    {
+        leaf->content = std::move(cached->second);
+        decompressed.erase(cached);
+    }
+    else
+    {
+        leaf->content = lzDecompress(leaf->packed, leaf->length);
+    }
+
+    leaf->packed = std::string();
+}
+
+size_t BTreeRope::leafBytes() const
+{
+    size_t bytes = 0;
+
+    for (const auto& node : collectLeaves())
+    {
+        auto leaf = asLeaf(node);
+        bytes += leaf->isCompressed() ? leaf->packed.capacity() : leaf->content.capacity();
+    }
+
+    return bytes;
+}
+
+BTreeNodePtr BTreeRope::makeLeaf(std::string content)
+{
+    auto leaf = std::make_shared<BTreeLeaf>();
+
+    leaf->length = content.length();
+    leaf->content = std::move(content);
+
+    return leaf;
+}
+
+BTreeNodePtr BTreeRope::makeBranch(const BTreeNodePtr* children, int count)
+{
+    auto branch = std::make_shared<BTreeBranch>();
+
+    branch->height = children[0]->height + 1;
+    branch->count = count;
+
+    int offset = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        offset += children[i]->length;
+
+        branch->children[i] = children[i];
+        branch->offsets[i] = offset;
+    }
+
+    branch->length = offset;
+
+    return branch;
+}
+
+BTreeNodePtr BTreeRope::fromChildren(const std::vector<BTreeNodePtr>& children)
+{
+    const int max = BTreeBranch::MAX_CHILDREN;
+
+    if (children.size() == 1)
+        return children.front();
+
+    if (children.size() <= max)
+        return makeBranch(children.data(), children.size());
+
+    // Joins never produce more than two full nodes worth of children.
+    int leftCount = children.size() / 2;
+
+    BTreeNodePtr halves[] = {
+        makeBranch(children.data(), leftCount),
+        makeBranch(children.data() + leftCount, children.size() - leftCount),
+    };
+
+    return makeBranch(halves, 2);
+}
+
+BTreeNodePtr BTreeRope::buildTree(std::vector<BTreeNodePtr> nodes)
+{
+    const int max = BTreeBranch::MAX_CHILDREN;
+
+    if (nodes.empty())
+        return nullptr;
+
+    while (nodes.size() > 1)
+    {
+        int groupCount = (nodes.size() + max - 1) / max;
+        int groupSize = nodes.size() / groupCount;
+        int remainder = nodes.size() % groupCount;
+
+        auto parents = std::vector<BTreeNodePtr>();
+        parents.reserve(groupCount);
+
+        int start = 0;
+
+        for (int i = 0; i < groupCount; i++)
+        {
+            int size = groupSize + (i < remainder ? 1 : 0);
+
+            parents.push_back(makeBranch(nodes.data() + start, size));
+            start += size;
+        }
+
+        nodes = std::move(parents);
+    }
+
+    return nodes.front();
+}
+
+BTreeNodePtr BTreeRope::join(const BTreeNodePtr& left, const BTreeNodePtr& right)
+{
+    if (left == nullptr || left->length == 0)
+        return right;
+
+    if (right == nullptr || right->length == 0)
+        return left;
+
+    // Children of a join result at the given height, which is either the result
+    // itself or, if the join overflowed into a new level, its children.
+    auto childrenAt = [](const BTreeNodePtr& node, int height)
+    {
+        if (node->height < height)
+            return std::vector<BTreeNodePtr>{node};
+
+        auto branch = asBranch(node);
+        return std::vector<BTreeNodePtr>(branch->children.begin(), branch->children.begin() + branch->count);
+    };
+
+    if (left->height < right->height)
+    {
+        auto branch = asBranch(right);
+        auto children = childrenAt(join(left, branch->children[0]), right->height);
+
+        children.insert(children.end(), branch->children.begin() + 1, branch->children.begin() + branch->count);
+
+        return fromChildren(children);
+    }
+
+    if (left->height > right->height)
+    {
+        auto branch = asBranch(left);
+        auto children = std::vector<BTreeNodePtr>(branch->children.begin(), branch->children.begin() + branch->count - 1);
+        auto last = childrenAt(join(branch->children[branch->count - 1], right), left->height);
+
+        children.insert(children.end(), last.begin(), last.end());
+
+        return fromChildren(children);
+    }
+
+    if (left->isLeaf())
+        return joinLeaves(left, right);
+
+    if (isBalanced(left) && isBalanced(right))
+        return makeBranch(std::vector<BTreeNodePtr>{left, right}.data(), 2);
+
+    auto children = childrenAt(left, left->height);
+    auto rightChildren = childrenAt(right, right->height);
+
+    children.insert(children.end(), rightChildren.begin(), rightChildren.end());
+
+    return fromChildren(children);
+}
+
+BTreeNodePtr BTreeRope::joinLeaves(const BTreeNodePtr& left, const BTreeNodePtr& right)
+{
+    if (isBalanced(left) && isBalanced(right))
+        return makeBranch(std::vector<BTreeNodePtr>{left, right}.data(), 2);
+
+    std::string leftScratch, rightScratch;
+    std::string content = unpacked(asLeaf(left), leftScratch) + unpacked(asLeaf(right), rightScratch);
+
+    if (content.length() <= MAX_LEAF)
+        return makeLeaf(std::move(content));
+
+    int half = content.length() / 2;
+
+    BTreeNodePtr leaves[] = {
+        makeLeaf(content.substr(0, half)),
+        makeLeaf(content.substr(half)),
+    };
+
+    return makeBranch(leaves, 2);
+}
+
+BTreeNodePtr BTreeRope::slice(const BTreeNodePtr& node, int start, int end)
+{
+    if (node == nullptr || start >= end)
+        return nullptr;
+
+    if (start <= 0 && end >= node->length)
+        return node;
+
+    start = std::max(start, 0);
+    end = std::min(end, node->length);
+
+    if (node->isLeaf())
+    {
+        std::string scratch;
+        return makeLeaf(unpacked(asLeaf(node), scratch).substr(start, end - start));
+    }
+
+    auto branch = asBranch(node);
+
+    BTreeNodePtr result;
+
+    for (int i = branch->childIndex(start); i < branch->count; i++)
+    {
+        int childStart = branch->childStart(i);
+
+        if (childStart >= end)
+            break;
+
+        auto part = slice(branch->children[i], start - childStart, end - childStart);
+        result = join(result, part);
+    }
+
+    return result;
+}
+
+bool BTreeRope::isBalanced(const BTreeNodePtr& node)
+{
+    if (node->isLeaf())
+        return node->length >= MIN_LEAF;
+
+    return asBranch(node)->count >= BTreeBranch::MIN_CHILDREN;
+}
+
+std::vector<BTreeNodePtr> BTreeRope::collectLeaves() const
+{
+    std::function<void(const BTreeNodePtr&, std::vector<BTreeNodePtr>&)> collect = [&](const BTreeNodePtr& node, std::vector<BTreeNodePtr>& leaves)
+    {
+        if (node == nullptr)
+            return;
+
+        if (node->isLeaf())
+        {
+            leaves.push_back(node);
+            return;
+        }
+
+        auto branch = asBranch(node);
+
+        for (int i = 0; i < branch->count; i++)
+            collect(branch->children[i], leaves);
+    };
+
+    std::vector<BTreeNodePtr> leaves;
+    collect(root, leaves);
+    return leaves;
+}
+
+// Text of a leaf for reads. Without compression enabled, this must not write:
+// the leaf may still be compressed by another rope sharing it.
+const std::string& BTreeRope::leafContent(const BTreeNodePtr& node, std::string& scratch) const
+{
+    auto leaf = asLeaf(node);
+
+    if (!compression)
+        return unpacked(leaf, scratch);
+
+    leaf->accessed = true;
+
+    if (!leaf->isCompressed())
+        return leaf->content;
+
+    for (auto it = decompressed.begin(); it != decompressed.end(); ++it)
+    {
+        if (it->first == node)
+        {
+            decompressed.splice(decompressed.begin(), decompressed, it);
+            return it->second;
+        }
+    }
+
+    if (decompressed.size() == DECOMPRESSED_CACHE_SIZE)
+        decompressed.pop_back();
+
+    decompressed.emplace_front(node, lzDecompress(leaf->packed, leaf->length));
+
+    return decompressed.front().second;
+}
+
+void BTreeRope::printBranches(const BTreeNodePtr& node, const std::string& prefix, bool isLeft) const
+{
+    if (node == nullptr)
+    {
+        std::cout << "└─ " << "<empty>" << std::endl;
+        return;
+    }
+
+    std::cout << prefix << (isLeft ? "├─ " : "└─ ");
+
+    std::string scratch;
+
+    if (node->isLeaf())
+        std::cout << "\033[32m" << "\"" << leafContent(node, scratch) << "\" (length=" << node->length << ")\033[0m\n";
+    else
+        std::cout << "\033[36m" << "[Node: length=" << node->length << ", children=" << asBranch(node)->count << "]\033[m\n";
+
+    if (node->isLeaf())
+        return;
+
+    auto branch = asBranch(node);
+    std::string childPrefix = prefix + (isLeft ? "│   " : "    ");
+
+    for (int i = 0; i < branch->count; i++)
+        printBranches(branch->children[i], childPrefix, i < branch->count - 1);
+}
@@ -0,0 +1,254 @@
+#include "byte_scan.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BYTE_SCAN_X86
+#include <immintrin.h>
+#endif
+
+// Scalar fallbacks, also used for the tails shorter than one vector.
+
+static int countByteScalar(const char* data, int length, char byte)
+{
+    int count = 0;
+
+    for (int i = 0; i < length; i++)
+        count += data[i] == byte;
+
+    return count;
+}
+
+static int findByteScalar(const char* data, int length, char byte)
+{
+    for (int i = 0; i < length; i++)
+        if (data[i] == byte)
+            return i;
+
+    return -1;
+}
+
+static int findLastByteScalar(const char* data, int length, char byte)
+{
+    for (int i = length - 1; i >= 0; i--)
+        if (data[i] == byte)
+            return i;
+
+    return -1;
+}
+
+static int countUtf8LeadBytesScalar(const char* data, int length)
+{
+    int count = 0;
+
+    for (int i = 0; i < length; i++)
+        count += (data[i] & 0xC0) != 0x80;
+
+    return count;
+}
+
+#ifdef BYTE_SCAN_X86
+
+__attribute__((target("sse2")))
+static int countByteSse2(const char* data, int length, char byte)
+{
+    const __m128i needle = _mm_set1_epi8(byte);
+
+    int count = 0;
+    int i = 0;
+
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+    }
+
+    return count + countByteScalar(data + i, length - i, byte);
+}
+
+__attribute__((target("sse2")))
+static int findByteSse2(const char* data, int length, char byte)
+{
+    const __m128i needle = _mm_set1_epi8(byte);
+
+    int i = 0;
+
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+
+    int tail = findByteScalar(data + i, length - i, byte);
+
+    return tail < 0 ? -1 : i + tail;
+}
+
+__attribute__((target("sse2")))
+static int findLastByteSse2(const char* data, int length, char byte)
+{
+    const __m128i needle = _mm_set1_epi8(byte);
+
+    int i = length;
+
+    for (; i - 16 >= 0; i -= 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i - 16));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+
+        if (mask != 0)
+            return i - 16 + 31 - __builtin_clz(mask);
+    }
+
+    return findLastByteScalar(data, i, byte);
+}
+
+__attribute__((target("sse2")))
+static int countUtf8LeadBytesSse2(const char* data, int length)
+{
+    // Continuation bytes are 0x80..0xBF, i.e. below -64 as signed bytes.
+    const __m128i threshold = _mm_set1_epi8(-64);
+
+    int continuations = 0;
+    int i = 0;
+
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        continuations += __builtin_popcount(_mm_movemask_epi8(_mm_cmpgt_epi8(threshold, chunk)));
+    }
+
+    return i - continuations + countUtf8LeadBytesScalar(data + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static int countByteAvx2(const char* data, int length, char byte)
+{
+    const __m256i needle = _mm256_set1_epi8(byte);
+
+    int count = 0;
+    int i = 0;
+
+    for (; i + 32 <= length; i += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        count += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+    }
+
+    return count + countByteSse2(data + i, length - i, byte);
+}
+
+__attribute__((target("avx2")))
+static int findByteAvx2(const char* data, int length, char byte)
+{
+    const __m256i needle = _mm256_set1_epi8(byte);
+
+    int i = 0;
+
+    for (; i + 32 <= length; i += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+
+    int tail = findByteSse2(data + i, length - i, byte);
+
+    return tail < 0 ? -1 : i + tail;
+}
+
+__attribute__((target("avx2")))
+static int findLastByteAvx2(const char* data, int length, char byte)
+{
+    const __m256i needle = _mm256_set1_epi8(byte);
+
+    int i = length;
+
+    for (; i - 32 >= 0; i -= 32)
+    {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i - 32));
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+
+        if (mask != 0)
+            return i - 32 + 31 - __builtin_clz(mask);
+    }
+
+    return findLastByteSse2(data, i, byte);
+}
+
+__attribute__((target("avx2")))
+static int countUtf8LeadBytesAvx2(const char* data, int length)
+{
+    const __m256i threshold = _mm256_set1_epi8(-64);
+
+    int continuations = 0;
+    int i = 0;
+
+    for (; i + 32 <= length; i += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        continuations += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpgt_epi8(threshold, chunk)));
+    }
+
+    return i - continuations + countUtf8LeadBytesSse2(data + i, length - i);
+}
+
+#endif
+
+struct ByteScanKernels
+{
+    const char* name;
+    int (*countByte)(const char*, int, char);
+    int (*findByte)(const char*, int, char);
+    int (*findLastByte)(const char*, int, char);
+    int (*countUtf8LeadBytes)(const char*, int);
+};
+
+static ByteScanKernels selectKernels()
+{
+#ifdef BYTE_SCAN_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+        return {"avx2", countByteAvx2, findByteAvx2, findLastByteAvx2, countUtf8LeadBytesAvx2};
+
+    if (__builtin_cpu_supports("sse2"))
+        return {"sse2", countByteSse2, findByteSse2, findLastByteSse2, countUtf8LeadBytesSse2};
+#endif
+
+    return {"scalar", countByteScalar, findByteScalar, findLastByteScalar, countUtf8LeadBytesScalar};
+}
+
+static const ByteScanKernels& kernels()
+{
+    static const ByteScanKernels selected = selectKernels();
+    return selected;
+}
+
+int countByte(const char* data, int length, char byte)
+{
+    return kernels().countByte(data, length, byte);
+}
+
+int findByte(const char* data, int length, char byte)
+{
+    return kernels().findByte(data, length, byte);
+}
+
+int findLastByte(const char* data, int length, char byte)
+{
+    return kernels().findLastByte(data, length, byte);
+}
+
+int countUtf8LeadBytes(const char* data, int length)
+{
+    return kernels().countUtf8LeadBytes(data, length);
+}
+
+const char* byteScanImplementation()
+{
+    return kernels().name;
+}
@@ -0,0 +1,114 @@
+#include "lz.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+static const int MIN_MATCH = 4;
+static const int MAX_MATCH = 0x7F + MIN_MATCH;
+static const int MAX_LITERALS = 0x80;
+static const int MAX_DISTANCE = 0xFFFF;
+static const int HASH_BITS = 12;
+
+static uint32_t hashAt(const char* data)
+{
+    uint32_t word;
+    std::memcpy(&word, data, sizeof(word));
+
+    return (word * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static void emitLiterals(std::string& output, const char* data, int length)
+{
+    while (length > 0)
+    {
+        int run = std::min(length, MAX_LITERALS);
+
+        output += char(run - 1);
+        output.append(data, run);
+
+        data += run;
+        length -= run;
+    }
+}
+
+std::string lzCompress(const std::string& input)
+{
+    const char* data = input.data();
+    const int length = input.length();
+
+    std::string output;
+    std::vector<int> table(1 << HASH_BITS, -1);
+
+    int literalStart = 0;
+    int i = 0;
+
+    while (i + MIN_MATCH <= length)
+    {
+        uint32_t hash = hashAt(data + i);
+        int candidate = table[hash];
+
+        table[hash] = i;
+
+        if (candidate < 0 || i - candidate > MAX_DISTANCE || std::memcmp(data + candidate, data + i, MIN_MATCH) != 0)
+        {
+            i++;
+            continue;
+        }
+
+        int matchLength = MIN_MATCH;
+
+        while (i + matchLength < length && matchLength < MAX_MATCH && data[candidate + matchLength] == data[i + matchLength])
+            matchLength++;
+
+        emitLiterals(output, data + literalStart, i - literalStart);
+
+        int distance = i - candidate;
+
+        output += char(0x80 | (matchLength - MIN_MATCH));
+        output += char(distance & 0xFF);
+        output += char(distance >> 8);
+
+        i += matchLength;
+        literalStart = i;
+    }
+
+    emitLiterals(output, data + literalStart, length - literalStart);
+
+    return output;
+}
+
+std::string lzDecompress(const std::string& input, int length)
+{
+    std::string output;
+    output.reserve(length);
+
+    size_t pos = 0;
+
+    while (pos < input.size())
+    {
+        unsigned char control = input[pos++];
+
+        if (control < 0x80)
+        {
+            int run = control + 1;
+
+            output.append(input, pos, run);
+            pos += run;
+            continue;
+        }
+
+        int matchLength = (control & 0x7F) + MIN_MATCH;
+        int distance = (unsigned char)input[pos] | ((unsigned char)input[pos + 1] << 8);
+        pos += 2;
+
+        // Matches may overlap the bytes they produce, so copy one at a time.
+        size_t from = output.size() - distance;
+
+        for (int k = 0; k < matchLength; k++)
+            output += output[from + k];
+    }
+
+    return output;
+}
@@ -0,0 +1,152 @@
+#include "pattern_matcher.hpp"
+
+#include <algorithm>
+#include <queue>
+
+PatternMatcher::PatternMatcher(const std::vector<std::string>& patterns)
+{
+    for (const auto& pattern : patterns)
+        for (unsigned char c : pattern)
+            if (byteClass[c] == 0)
+                byteClass[c] = classCount++;
+
+    addNode();
+
+    for (size_t id = 0; id < patterns.size(); id++)
+    {
+        const auto& pattern = patterns[id];
+
+        lengths.push_back(pattern.length());
+        maxLength = std::max<int>(maxLength, pattern.length());
+
+        if (pattern.empty())
+            continue;
+
+        int node = 0;
+
+        for (unsigned char c : pattern)
+        {
+            int& next = transitions[node * classCount + byteClass[c]];
+
+            if (next < 0)
+            {
+                int child = addNode();
+                transitions[node * classCount + byteClass[c]] = child;
+                node = child;
+            }
+            else
+            {
+                node = next;
+            }
+        }
+
+        outputs[node].push_back(id);
+    }
+
+    // Breadth-first pass turning the trie into a complete DFA: missing edges
+    // follow the failure link, and each node links to the nearest node on its
+    // failure chain that ends a pattern.
+    std::vector<int> failure(outputs.size(), 0);
+    std::queue<int> queue;
+
+    for (int c = 0; c < classCount; c++)
+    {
+        int& next = transitions[c];
+
+        if (next < 0)
+            next = 0;
+        else
+            queue.push(next);
+    }
+
+    while (!queue.empty())
+    {
+        int node = queue.front();
+        queue.pop();
+
+        int fail = failure[node];
+
+        outputLinks[node] = outputs[fail].empty() ? outputLinks[fail] : fail;
+        hasOutput[node] = !outputs[node].empty() || outputLinks[node] >= 0;
+
+        for (int c = 0; c < classCount; c++)
+        {
+            int& next = transitions[node * classCount + c];
+            int fallback = transitions[fail * classCount + c];
+
+            if (next < 0)
+            {
+                next = fallback;
+                continue;
+            }
+
+            failure[next] = fallback;
+            queue.push(next);
+        }
+    }
+}
+
+template <typename RefCount>
+std::vector<PatternMatcher::Match> PatternMatcher::scan(const BasicRope<RefCount>& rope, int start, int end) const
+{
+    std::vector<Match> matches;
+
+    State state;
+    state.offset = std::clamp(start, 0, rope.length());
+
+    scan(rope, state, end, matches);
+
+    return matches;
+}
+
+template <typename RefCount>
+void PatternMatcher::scan(const BasicRope<RefCount>& rope, State& state, int end, std::vector<Match>& matches) const
+{
+    if (end < 0 || end > rope.length())
+        end = rope.length();
+
+    rope.forEachChunk(state.offset, end, [&](const char* data, int length, int)
+    {
+        feed(state, data, length, matches);
+        return true;
+    });
+
+    state.offset = std::max(state.offset, end);
+}
+
+template std::vector<PatternMatcher::Match> PatternMatcher::scan(const Rope&, int, int) const;
+template std::vector<PatternMatcher::Match> PatternMatcher::scan(const LocalRope&, int, int) const;
+template void PatternMatcher::scan(const Rope&, State&, int, std::vector<Match>&) const;
+template void PatternMatcher::scan(const LocalRope&, State&, int, std::vector<Match>&) const;
+
+void PatternMatcher::feed(State& state, const char* data, int length, std::vector<Match>& matches) const
+{
+    int node = state.node;
+
+    for (int i = 0; i < length; i++)
+    {
+        node = transitions[node * classCount + byteClass[(unsigned char)data[i]]];
+
+        if (!hasOutput[node])
+            continue;
+
+        int end = state.offset + i + 1;
+
+        for (int output = node; output >= 0; output = outputLinks[output])
+            for (int id : outputs[output])
+                matches.push_back({id, end - lengths[id]});
+    }
+
+    state.node = node;
+    state.offset += length;
+}
+
+int PatternMatcher::addNode()
+{
+    transitions.resize(transitions.size() + classCount, -1);
+    outputs.emplace_back();
+    outputLinks.push_back(-1);
+    hasOutput.push_back(false);
+
+    return outputs.size() - 1;
+}
@@ -1,250 +1,1008 @@
 #include "rope.hpp"
+#include "byte_scan.hpp"
+#include "rope_pool.hpp"
 
 #include <algorithm>
+#include <climits>
 #include <cmath>
 #include <cstring>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <stdexcept>
 #include <utility>
 
-Rope::Rope(const std::string& str)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+template <typename RefCount>
+BasicRope<RefCount>::BasicRope(const std::string& str)
 {
-    int leafCount = std::ceil(str.length() / float(MAX_WEIGHT));
+    root = buildTree(std::string_view(str));
+}
+
+template <typename RefCount>
+BasicRope<RefCount>::BasicRope(const char* str)
+    : BasicRope(std::string(str))
+{}
+
+template <typename RefCount>
+BasicRope<RefCount>::BasicRope(char c)
+    : BasicRope(std::string(1, c))
+{}
+
+template <typename RefCount>
+bool BasicRope<RefCount>::operator==(const BasicRope& other) const
+{
+    if (root == other.root)
+        return true;
+
+    return length() == other.length() && compare(other) == 0;
+}
+
+template <typename RefCount>
+bool BasicRope<RefCount>::operator!=(const BasicRope& other) const
+{
+    return !(*this == other);
+}
+
+template <typename RefCount>
+bool BasicRope<RefCount>::operator<(const BasicRope& other) const
+{
+    return compare(other) < 0;
+}
+
+template <typename RefCount>
+bool BasicRope<RefCount>::operator<=(const BasicRope& other) const
+{
+    return compare(other) <= 0;
+}
+
+template <typename RefCount>
+bool BasicRope<RefCount>::operator>(const BasicRope& other) const
+{
+    return compare(other) > 0;
+}
+
+template <typename RefCount>
+bool BasicRope<RefCount>::operator>=(const BasicRope& other) const
+{
+    return compare(other) >= 0;
+}
+
+template <typename RefCount>
+int BasicRope<RefCount>::compare(const BasicRope& other) const
+{
+    int thisLength = length();
+    int otherLength = other.length();
+
+    ChunkCursor a(root.get(), 0);
+    ChunkCursor b(other.root.get(), 0);
+
+    int order = 0;
+    compareChunks(a, b, std::min(thisLength, otherLength), order);
+
+    if (order != 0)
+        return order;
+
+    return thisLength < otherLength ? -1 : (thisLength > otherLength ? 1 : 0);
+}
+
+template <typename RefCount>
+int BasicRope<RefCount>::commonPrefixLength(const BasicRope& other) const
+{
+    ChunkCursor a(root.get(), 0);
+    ChunkCursor b(other.root.get(), 0);
+
+    int order = 0;
+    return compareChunks(a, b, std::min(length(), other.length()), order);
+}
+
+template <typename RefCount>
+bool BasicRope<RefCount>::startsWith(const BasicRope& prefix) const
+{
+    int prefixLength = prefix.length();
+
+    return prefixLength <= length() && commonPrefixLength(prefix) == prefixLength;
+}
+
+template <typename RefCount>
+bool BasicRope<RefCount>::endsWith(const BasicRope& suffix) const
+{
+    int suffixLength = suffix.length();
+
+    if (suffixLength > length())
+        return false;
+
+    ChunkCursor a(root.get(), length() - suffixLength);
+    ChunkCursor b(suffix.root.get(), 0);
+
+    int order = 0;
+    return compareChunks(a, b, suffixLength, order) == suffixLength;
+}
+
+template <typename RefCount>
+bool BasicRope<RefCount>::sameStructure(const BasicRope& other) const
+{
+    std::function<bool(NodePtr, NodePtr)> cmpNode = [&] (NodePtr node, NodePtr other) -> bool
+    {
+        if (node == nullptr || other == nullptr)
+            return node == nullptr && other == nullptr;
+
+        if (node->isLeaf())
+        {
+            if (!other->isLeaf())
+                return false;
+
+            return node->content == other->content
+                && node->weight == other->weight;
+        }
+
+        return cmpNode(node->lChild, other->lChild)
+            && cmpNode(node->rChild, other->rChild)
+            && node->weight == other->weight;
+    };
+
+    return cmpNode(root, other.root);
+}
+
+template <typename RefCount>
+std::string BasicRope<RefCount>::asString() const
+{
+    return nodeAsString(root);
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::print() const
+{
+    std::cout << "Rope Tree" << std::endl;
+
+    printBranches(root);
+}
+
+template <typename RefCount>
+std::pair<BasicRope<RefCount>, BasicRope<RefCount>> BasicRope<RefCount>::split(int index) const&
+{
+    if (root == nullptr)
+        return {BasicRope(), BasicRope()};
+
+    if (index < 0 || index > nodeLength(root))
+        return {BasicRope(), BasicRope()};
+
+    auto [left, right] = splitNode(root, index, false);
+
+    BasicRope leftRope, rightRope;
+
+    leftRope.root = left;
+    rightRope.root = right;
+
+    return {leftRope, rightRope};
+}
+
+template <typename RefCount>
+std::pair<BasicRope<RefCount>, BasicRope<RefCount>> BasicRope<RefCount>::split(int index) &&
+{
+    if (root == nullptr)
+        return {BasicRope(), BasicRope()};
+
+    if (index < 0 || index > nodeLength(root))
+        return {BasicRope(), BasicRope()};
+
+    invalidateFinger();
+
+    auto [left, right] = splitNode(std::move(root), index, true);
+
+    BasicRope leftRope, rightRope;
+
+    leftRope.root = std::move(left);
+    rightRope.root = std::move(right);
+
+    return {std::move(leftRope), std::move(rightRope)};
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::concat(const BasicRope& other)
+{
+    // Sharing other's nodes is safe, since shared nodes are never edited in place.
+    concat(BasicRope(other));
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::concat(BasicRope&& other)
+{
+    if (&other == this)
+    {
+        concat(BasicRope(other));
+        return;
+    }
+
+    int oldLength = length();
+
+    if (other.length() <= MAX_WEIGHT && insertAtFinger(other.asString(), oldLength))
+    {
+        recordEdit({oldLength, 0, length() - oldLength});
+        return;
+    }
+
+    if (other.root == nullptr)
+        return;
+
+    other.invalidateFinger();
+
+    NodePtr newRoot = makeIntrusive<Node>();
+
+    newRoot->lChild = root;
+    newRoot->rChild = std::move(other.root);
+    newRoot->weight = oldLength;
+    newRoot->newlines = nodeNewlines(newRoot->lChild) + nodeNewlines(newRoot->rChild);
+
+    root = std::move(newRoot);
+
+    rebalance();
+    recordEdit({oldLength, 0, length() - oldLength});
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::insert(const BasicRope& other, int index)
+{
+    insert(BasicRope(other), index);
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::insert(BasicRope&& other, int index)
+{
+    if (index < 0 || index > nodeLength(root))
+        throw std::out_of_range("Index out of range");
+
+    if (&other == this)
+    {
+        insert(BasicRope(other), index);
+        return;
+    }
+
+    int inserted = other.length();
+
+    if (inserted <= MAX_WEIGHT && insertAtFinger(other.asString(), index))
+    {
+        recordEdit({index, 0, inserted});
+        return;
+    }
+
+    // Nothing else holds the root once this rope is split by value, so
+    // rebalance() below reuses the nodes instead of copying them first.
+    auto [left, right] = std::move(*this).split(index);
+
+    left.concat(std::move(other));
+    left.concat(std::move(right));
+
+    root = std::move(left.root);
+
+    rebalance();
+    recordEdit({index, 0, inserted});
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::append(std::string_view str)
+{
+    concat(fromText(str));
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::append(std::string&& str)
+{
+    concat(fromText(std::move(str)));
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::append(const char* str)
+{
+    append(std::string_view(str));
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::prepend(std::string_view str)
+{
+    insert(fromText(str), 0);
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::prepend(std::string&& str)
+{
+    insert(fromText(std::move(str)), 0);
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::prepend(const char* str)
+{
+    prepend(std::string_view(str));
+}
+
+template <typename RefCount>
+char BasicRope<RefCount>::at(int index) const
+{
+    if (fingerCovers(index, false))
+        return finger.path.back()->content[index - finger.start];
+
+    if (index < 0 || index >= length())
+        return '\0';
+
+    const Node* node = root.get();
+
+    while (!node->isLeaf())
+    {
+        if ((index < node->weight && node->lChild != nullptr) || node->rChild == nullptr)
+        {
+            node = node->lChild.get();
+        }
+        else
+        {
+            index -= node->weight;
+            node = node->rChild.get();
+        }
+    }
+
+    if (index >= node->weight)
+        return '\0';
+
+    return node->content[index];
+}
+
+template <typename RefCount>
+BasicRope<RefCount> BasicRope<RefCount>::subString(int start, int end) const
+{
+    if (start < 0 || start > length() || end < 0 || end > length())
+        throw std::out_of_range("Index out of range");
+
+    if (start >= end)
+        return BasicRope();
+
+    auto [left, right] = split(end);
+    auto [_, mid] = std::move(left).split(start);
+
+    return mid;
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::erase(int start, int end)
+{
+    if (start < 0 || start > length() || end < 0 || end > length())
+        throw std::out_of_range("Index out of range");
+
+    if (start >= end)
+        return;
+
+    // Short ranges are erased in place leaf by leaf, from the end, so that
+    // backspacing over a leaf boundary stays local too.
+    int remaining = end;
+
+    if (end - start <= MAX_LEAF_GROWTH)
+    {
+        while (remaining > start)
+        {
+            int erased = eraseAtFinger(start, remaining);
+
+            if (erased == 0)
+                break;
+
+            remaining -= erased;
+        }
+    }
+
+    if (remaining > start)
+    {
+        auto [left, last] = std::move(*this).split(remaining);
+        auto [first, mid] = std::move(left).split(start);
+
+        first.concat(std::move(last));
+        root = std::move(first.root);
+
+        rebalance();
+    }
+
+    recordEdit({start, end - start, 0});
+}
+
+
+int RopeDelta::transform(int position, bool afterInsert) const
+{
+    if (position < offset || (position == offset && !afterInsert))
+        return position;
+
+    if (position >= offset + removed)
+        return position - removed + inserted;
+
+    return offset + (afterInsert ? inserted : 0);
+}
+
+int RopeDelta::transform(int position, const std::vector<RopeDelta>& deltas, bool afterInsert)
+{
+    for (const auto& delta : deltas)
+        position = delta.transform(position, afterInsert);
+
+    return position;
+}
+
+bool RopeDelta::merge(const RopeDelta& next)
+{
+    // next is in the coordinates of the text after this edit, in which this
+    // edit left [offset, offset + inserted). Merge only if the two touch.
+    if (next.offset > offset + inserted || next.offset + next.removed < offset)
+        return false;
+
+    int start = std::min(offset, next.offset);
+    int end = std::max(offset + inserted, next.offset + next.removed);
+
+    int mergedRemoved = end - inserted + removed - start;
+    int mergedInserted = end - start - next.removed + next.inserted;
+
+    offset = start;
+    removed = mergedRemoved;
+    inserted = mergedInserted;
+
+    return true;
+}
+
+template <typename RefCount>
+BasicRope<RefCount>::ChunkCursor::ChunkCursor(const Node* root, int start)
+{
+    if (root == nullptr)
+        return;
+
+    const Node* node = root;
+
+    while (!node->isLeaf())
+    {
+        if ((start < node->weight && node->lChild != nullptr) || node->rChild == nullptr)
+        {
+            if (node->rChild != nullptr)
+                pending.push_back(node->rChild.get());
+
+            node = node->lChild.get();
+        }
+        else
+        {
+            start -= node->weight;
+            node = node->rChild.get();
+        }
+    }
+
+    data = node->content.data() + start;
+    size = node->content.length() - start;
+
+    if (size == 0)
+        nextLeaf();
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::ChunkCursor::advance(int count)
+{
+    data += count;
+    size -= count;
+
+    if (size == 0)
+        nextLeaf();
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::ChunkCursor::nextLeaf()
+{
+    // Skips empty leaves, which have no bytes to compare.
+    while (size == 0 && !pending.empty())
+    {
+        const Node* node = pending.back();
+        pending.pop_back();
+
+        while (!node->isLeaf())
+        {
+            if (node->lChild == nullptr)
+            {
+                node = node->rChild.get();
+                continue;
+            }
+
+            if (node->rChild != nullptr)
+                pending.push_back(node->rChild.get());
+
+            node = node->lChild.get();
+        }
+
+        data = node->content.data();
+        size = node->content.length();
+    }
+}
+
+template <typename RefCount>
+int BasicRope<RefCount>::compareChunks(ChunkCursor& a, ChunkCursor& b, int length, int& order)
+{
+    int matched = 0;
+
+    order = 0;
+
+    while (matched < length && !a.done() && !b.done())
+    {
+        int count = std::min({a.size, b.size, length - matched});
+
+        // Shared leaves at the same position need no comparison.
+        if (a.data != b.data && std::memcmp(a.data, b.data, count) != 0)
+        {
+            int i = 0;
+
+            while (a.data[i] == b.data[i])
+                i++;
+
+            order = (unsigned char)a.data[i] < (unsigned char)b.data[i] ? -1 : 1;
+            return matched + i;
+        }
+
+        matched += count;
+        a.advance(count);
+        b.advance(count);
+    }
+
+    return matched;
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::rebalance()
+{
+    copyOnWrite();
+    invalidateFinger();
+
+    auto leaves = collectLeaves();
+    root = buildTree(leaves);
+}
+
+template <typename RefCount>
+int BasicRope<RefCount>::length() const
+{
+    return nodeLength(root);
+}
+
+template <typename RefCount>
+int BasicRope<RefCount>::count(char c) const
+{
+    if (c == '\n')
+        return newlineCount();
+
+    int result = 0;
+
+    forEachChunk(0, length(), [&](const char* data, int size, int)
+    {
+        result += countByte(data, size, c);
+        return true;
+    });
+
+    return result;
+}
+
+template <typename RefCount>
+int BasicRope<RefCount>::find(char c, int start) const
+{
+    int result = -1;
+
+    forEachChunk(std::max(start, 0), length(), [&](const char* data, int size, int offset)
+    {
+        int index = findByte(data, size, c);
+
+        if (index >= 0)
+            result = offset + index;
+
+        return index < 0;
+    });
+
+    return result;
+}
+
+template <typename RefCount>
+int BasicRope<RefCount>::findLast(char c) const
+{
+    std::function<int(const Node*, int)> findInNode = [&](const Node* node, int offset) -> int
+    {
+        if (node == nullptr)
+            return -1;
+
+        if (node->isLeaf())
+        {
+            int index = findLastByte(node->content.data(), node->content.length(), c);
+            return index < 0 ? -1 : offset + index;
+        }
+
+        int index = findInNode(node->rChild.get(), offset + node->weight);
+
+        if (index >= 0)
+            return index;
+
+        return findInNode(node->lChild.get(), offset);
+    };
+
+    return findInNode(root.get(), 0);
+}
+
+template <typename RefCount>
+int BasicRope<RefCount>::newlineCount() const
+{
+    return nodeNewlines(root);
+}
+
+template <typename RefCount>
+int BasicRope<RefCount>::utf8Length() const
+{
+    int result = 0;
+
+    forEachChunk(0, length(), [&](const char* data, int size, int)
+    {
+        result += countUtf8LeadBytes(data, size);
+        return true;
+    });
+
+    return result;
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::intern(BasicRopePool<RefCount>& pool)
+{
+    root = pool.intern(root);
+    invalidateFinger();
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::markSaved(const std::string& path)
+{
+    struct stat status;
+
+    saved.path = path;
+    saved.dirty.clear();
+    saved.size = -1;
+
+    if (stat(path.c_str(), &status) == 0)
+    {
+        saved.device = status.st_dev;
+        saved.inode = status.st_ino;
+        saved.size = status.st_size;
+        saved.modified = status.st_mtim.tv_sec * 1000000000LL + status.st_mtim.tv_nsec;
+    }
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::save(const std::string& path)
+{
+    // The file only holds the previous content if it was the last save target
+    // and is still the same file, unchanged since then. It is opened without
+    // O_CREAT so that a deleted file is not recreated as a sparse one.
+    bool incremental = false;
+    int fd = -1;
+
+    if (path == saved.path && saved.size >= 0)
+    {
+        struct stat status;
+
+        fd = open(path.c_str(), O_WRONLY);
+        incremental = fd >= 0 && fstat(fd, &status) == 0
+            && status.st_dev == saved.device && status.st_ino == saved.inode && status.st_size == saved.size
+            && status.st_mtim.tv_sec * 1000000000LL + status.st_mtim.tv_nsec == saved.modified;
+    }
+
+    if (!incremental)
+    {
+        if (fd >= 0)
+            close(fd);
+
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+
+    if (fd < 0)
+        throw std::runtime_error("Could not open " + path);
+
+    auto ranges = incremental ? saved.dirty : std::vector<std::pair<int, int>>{{0, length()}};
+    std::vector<iovec> chunks;
+    off_t offset = 0;
+    bool ok = true;
+
+    // Leaf content is handed to pwritev directly, so the rope is never flattened.
+    auto flush = [&]()
+    {
+        size_t chunk = 0;
+
+        while (ok && chunk < chunks.size())
+        {
+            int count = std::min<size_t>(chunks.size() - chunk, IOV_MAX);
+            ssize_t written = pwritev(fd, chunks.data() + chunk, count, offset);
+
+            if (written <= 0)
+            {
+                ok = false;
+                break;
+            }
+
+            offset += written;
+
+            while (chunk < chunks.size() && size_t(written) >= chunks[chunk].iov_len)
+                written -= chunks[chunk++].iov_len;
+
+            if (chunk < chunks.size())
+            {
+                chunks[chunk].iov_base = static_cast<char*>(chunks[chunk].iov_base) + written;
+                chunks[chunk].iov_len -= written;
+            }
+        }
 
-    auto leaves = std::vector<RopeNodePtr>(leafCount);
+        chunks.clear();
+    };
 
-    for (int i = 0; i < leafCount; i++)
+    for (auto [start, end] : ranges)
     {
-        int startIndex = i * MAX_WEIGHT;
+        offset = start;
+
+        forEachChunk(start, end, [&](const char* data, int size, int)
+        {
+            chunks.push_back({const_cast<char*>(data), size_t(size)});
 
-        leaves[i] = std::make_shared<RopeNode>();
-        leaves[i]->content = str.substr(startIndex, MAX_WEIGHT);
-        leaves[i]->weight = leaves[i]->content.length();
+            if (chunks.size() == IOV_MAX)
+                flush();
+
+            return ok;
+        });
+
+        flush();
     }
 
-    root = buildTree(leaves);
-}
+    ok = ok && ftruncate(fd, length()) == 0;
+    ok = close(fd) == 0 && ok;
 
-Rope::Rope(const char* str)
-    : Rope(std::string(str))
-{}
+    if (!ok)
+        throw std::runtime_error("Could not write " + path);
 
-Rope::Rope(char c)
-    : Rope(std::string(1, c))
-{}
+    markSaved(path);
+}
 
-bool Rope::operator==(const Rope& other) const
+template <typename RefCount>
+int BasicRope<RefCount>::addObserver(EditObserver observer)
 {
-    std::function<bool(RopeNodePtr, RopeNodePtr)> cmpNode = [&] (RopeNodePtr node, RopeNodePtr other) -> bool
-    {
-        if (node == nullptr || other == nullptr)
-            return node == nullptr && other == nullptr;
+    edits.observers.emplace_back(edits.nextObserverId, std::move(observer));
+    return edits.nextObserverId++;
+}
 
-        if (node->isLeaf())
-        {
-            if (!other->isLeaf())
-                return false;
+template <typename RefCount>
+void BasicRope<RefCount>::removeObserver(int id)
+{
+    auto& observers = edits.observers;
 
-            return node->content == other->content
-                && node->weight == other->weight;
-        }
+    observers.erase(std::remove_if(observers.begin(), observers.end(), [&](const auto& entry) { return entry.first == id; }), observers.end());
+}
 
-        return cmpNode(node->lChild, other->lChild)
-            && cmpNode(node->rChild, other->rChild)
-            && node->weight == other->weight;
-    };
+template <typename RefCount>
+void BasicRope<RefCount>::setDeltaLogging(bool enabled)
+{
+    edits.logging = enabled;
 
-    return cmpNode(root, other.root);
+    if (!enabled)
+        edits.deltas.clear();
 }
 
-std::string Rope::asString() const
+template <typename RefCount>
+std::vector<RopeDelta> BasicRope<RefCount>::takeDeltas()
 {
-    return nodeAsString(root);
+    return std::exchange(edits.deltas, {});
 }
 
-void Rope::print() const
+template <typename RefCount>
+void BasicRope<RefCount>::recordEdit(const RopeDelta& delta)
 {
-    std::cout << "Rope Tree" << std::endl;
+    if (delta.removed == 0 && delta.inserted == 0)
+        return;
 
-    printBranches(root);
+    // Edits that change the length shift everything after them.
+    markDirty(delta.offset, delta.removed == delta.inserted ? delta.offset + delta.inserted : length());
+
+    if (edits.logging)
+    {
+        auto& deltas = edits.deltas;
+
+        if (deltas.empty() || !deltas.back().merge(delta))
+            deltas.push_back(delta);
+    }
+
+    for (const auto& [id, observer] : edits.observers)
+        observer(delta);
 }
 
-std::pair<Rope, Rope> Rope::split(int index) const
+template <typename RefCount>
+void BasicRope<RefCount>::markDirty(int start, int end)
 {
-    if (root == nullptr)
-        return {Rope(), Rope()};
+    auto& dirty = saved.dirty;
 
-    if (index < 0 || index > nodeLength(root))
-        return {Rope(), Rope()};
+    // Ranges past the end of a rope that shrank no longer exist.
+    int newLength = length();
 
-    std::function<std::pair<RopeNodePtr, RopeNodePtr>(RopeNodePtr, int)> splitNode = [&](RopeNodePtr node, int index) -> std::pair<RopeNodePtr, RopeNodePtr>
-    {
-        if (node->isLeaf())
-        {
-            if (index == 0)
-                return {nullptr, node};
+    while (!dirty.empty() && dirty.back().first >= newLength)
+        dirty.pop_back();
 
-            if (index == node->content.length())
-                return {node, nullptr};
+    if (!dirty.empty())
+        dirty.back().second = std::min(dirty.back().second, newLength);
 
-            std::string leftString = node->content.substr(0, index);
-            std::string rightString = node->content.substr(index);
+    if (start >= end)
+        return;
 
-            auto left = std::make_shared<RopeNode>();
-            left->content = leftString;
-            left->weight = leftString.length();
+    // Keep the ranges sorted and disjoint, merging anything that overlaps or touches.
+    auto it = dirty.begin();
 
-            auto right = std::make_shared<RopeNode>();
-            right->content = rightString;
-            right->weight = rightString.length();
+    while (it != dirty.end() && it->second < start)
+        ++it;
 
-            return {left, right};
-        }
+    while (it != dirty.end() && it->first <= end)
+    {
+        start = std::min(start, it->first);
+        end = std::max(end, it->second);
+        it = dirty.erase(it);
+    }
 
-        if (index < node->weight)
-        {
-            auto [left, right] = splitNode(node->lChild, index);
+    dirty.insert(it, {start, end});
+}
 
-            auto newRight = std::make_shared<RopeNode>();
-            newRight->lChild = right;
-            newRight->rChild = node->rChild;
-            newRight->weight = node->weight - index;
+template <typename RefCount>
+void BasicRope<RefCount>::forEachChunk(int start, int end, const ChunkVisitor& visit) const
+{
+    std::function<bool(const Node*, int)> visitNode = [&](const Node* node, int offset) -> bool
+    {
+        if (node == nullptr)
+            return true;
 
-            return {left, newRight};
-        }
-        else if (index == node->weight)
-        {
-            return {node->lChild, node->rChild};
-        }
-        else
+        if (node->isLeaf())
         {
-            auto [left, right] = splitNode(node->rChild, index - node->weight);
+            int from = std::max(start - offset, 0);
+            int to = std::min(end - offset, node->weight);
 
-            auto newLeft = std::make_shared<RopeNode>();
-            newLeft->lChild = node->lChild;
-            newLeft->rChild = left;
-            newLeft->weight = node->weight;
+            if (from >= to)
+                return true;
 
-            return {newLeft, right};
+            return visit(node->content.data() + from, to - from, offset + from);
         }
-    };
 
-    auto [left, right] = splitNode(root, index);
+        if (start < offset + node->weight && !visitNode(node->lChild.get(), offset))
+            return false;
 
-    Rope leftRope, rightRope;
+        if (end > offset + node->weight)
+            return visitNode(node->rChild.get(), offset + node->weight);
 
-    leftRope.root = left;
-    rightRope.root = right;
+        return true;
+    };
 
-    return {leftRope, rightRope};
+    visitNode(root.get(), 0);
 }
 
-void Rope::concat(const Rope& other)
+template <typename RefCount>
+BasicRopeNodePtr<RefCount> BasicRope<RefCount>::buildTree(std::string_view str)
 {
-    copyOnWrite();
+    int leafCount = std::ceil(str.length() / float(MAX_WEIGHT));
 
-    RopeNodePtr newRoot = std::make_shared<RopeNode>();
+    auto leaves = std::vector<NodePtr>(leafCount);
+    auto newlines = std::vector<int>(leafCount);
 
-    newRoot->lChild = root;
-    newRoot->rChild = copySubtree(other.root);
-    newRoot->weight = length();
+    // Leaves are far shorter than a vector register, so find the newlines in
+    // the whole input at once and bucket them by leaf.
+    for (int i = findByte(str.data(), str.length(), '\n'); i >= 0;)
+    {
+        newlines[i / MAX_WEIGHT]++;
 
-    root = newRoot;
+        int next = findByte(str.data() + i + 1, str.length() - i - 1, '\n');
+        i = next < 0 ? -1 : i + 1 + next;
+    }
 
-    rebalance();
+    for (int i = 0; i < leafCount; i++)
+        leaves[i] = makeLeaf(std::string(str.substr(i * MAX_WEIGHT, MAX_WEIGHT)), newlines[i]);
+
+    return buildTree(leaves);
 }
 
-void Rope::insert(const Rope& other, int index)
+template <typename RefCount>
+BasicRope<RefCount> BasicRope<RefCount>::fromText(std::string_view str)
 {
-    if (index < 0 || index > nodeLength(root))
-        throw std::out_of_range("Index out of range");
+    BasicRope rope;
+    rope.root = rope.buildTree(str);
 
-    copyOnWrite();
+    return rope;
+}
 
-    auto [left, right] = split(index);
+template <typename RefCount>
+BasicRope<RefCount> BasicRope<RefCount>::fromText(std::string&& str)
+{
+    if (str.length() > MAX_WEIGHT)
+        return fromText(std::string_view(str));
 
-    left.concat(other);
-    left.concat(right);
+    // Short enough for one leaf, which can take over the buffer.
+    BasicRope rope;
 
-    root = left.root;
+    if (!str.empty())
+        rope.root = makeLeaf(std::move(str));
 
-    rebalance();
+    return rope;
 }
 
-char Rope::at(int index) const
+template <typename RefCount>
+BasicRopeNodePtr<RefCount> BasicRope<RefCount>::makeLeaf(std::string content)
 {
-    if (index < 0 || index >= length())
-        return '\0';
+    int newlines = contentNewlines(content);
 
-    std::function<char(RopeNodePtr, int)> findChar = [&](RopeNodePtr node, int index) -> char
-    {
-        if (node == nullptr)
-            return '\0';
-
-        if (node->isLeaf())
-        {
-            if (index >= node->weight)
-                return '\0';
-
-            return node->content.at(index);
-        }
+    return makeLeaf(std::move(content), newlines);
+}
 
-        if (index < node->weight)
-            return findChar(node->lChild, index);
+template <typename RefCount>
+BasicRopeNodePtr<RefCount> BasicRope<RefCount>::makeLeaf(std::string content, int newlines)
+{
+    auto leaf = makeIntrusive<Node>();
 
-        return findChar(node->rChild, index - node->weight);
-    };
+    leaf->weight = content.length();
+    leaf->newlines = newlines;
+    leaf->content = std::move(content);
 
-    return findChar(root, index);
+    return leaf;
 }
 
-Rope Rope::subString(int start, int end) const
+template <typename RefCount>
+std::pair<BasicRopeNodePtr<RefCount>, BasicRopeNodePtr<RefCount>> BasicRope<RefCount>::splitNode(NodePtr node, int index, bool steal)
 {
-    if (start < 0 || start > length() || end < 0 || end > length())
-        throw std::out_of_range("Index out of range");
+    // With steal set, a node nothing else refers to is reused as one of the
+    // halves instead of being copied. Ownership is only passed down through
+    // owned nodes, so shared subtrees are never touched.
+    bool owned = steal && node.useCount() == 1;
 
-    if (start >= end)
-        return Rope();
+    if (node->isLeaf())
+    {
+        if (index == 0)
+            return {nullptr, node};
 
-    auto [left, right] = split(end);
-    auto [_, mid] = left.split(start);
+        if (index == node->content.length())
+            return {node, nullptr};
 
-    return mid;
-}
+        auto right = makeLeaf(node->content.substr(index));
 
-void Rope::erase(int start, int end)
-{
-    if (start < 0 || start > length() || end < 0 || end > length())
-        throw std::out_of_range("Index out of range");
+        if (!owned)
+            return {makeLeaf(node->content.substr(0, index)), right};
 
-    if (start >= end)
-        return;
+        node->content.resize(index);
+        node->weight = index;
+        node->newlines = contentNewlines(node->content);
 
-    auto [left, last] = split(end);
-    auto [first, mid] = left.split(start);
+        return {node, right};
+    }
 
-    first.concat(last);
-    root = first.root;
+    if (index < node->weight)
+    {
+        auto [left, right] = splitNode(owned ? std::move(node->lChild) : node->lChild, index, steal);
 
-    rebalance();
-}
+        auto newRight = owned ? node : makeIntrusive<Node>();
+        newRight->weight = node->weight - index;
+        newRight->lChild = right;
+        newRight->rChild = node->rChild;
+        newRight->newlines = nodeNewlines(right) + nodeNewlines(node->rChild);
 
+        return {left, newRight};
+    }
+    else if (index == node->weight)
+    {
+        if (owned)
+            return {std::move(node->lChild), std::move(node->rChild)};
 
-void Rope::rebalance()
-{
-    copyOnWrite();
+        return {node->lChild, node->rChild};
+    }
+    else
+    {
+        auto [left, right] = splitNode(owned ? std::move(node->rChild) : node->rChild, index - node->weight, steal);
 
-    auto leaves = collectLeaves();
-    root = buildTree(leaves);
-}
+        auto newLeft = owned ? node : makeIntrusive<Node>();
+        newLeft->lChild = node->lChild;
+        newLeft->rChild = left;
+        newLeft->weight = node->weight;
+        newLeft->newlines = nodeNewlines(node->lChild) + nodeNewlines(left);
 
-int Rope::length() const
-{
-    return nodeLength(root);
+        return {newLeft, right};
+    }
 }
 
-RopeNodePtr Rope::buildTree(std::vector<RopeNodePtr>& leaves)
+template <typename RefCount>
+BasicRopeNodePtr<RefCount> BasicRope<RefCount>::buildTree(std::vector<NodePtr>& leaves)
 {
     if (leaves.empty())
         return nullptr;
@@ -261,10 +1019,11 @@ RopeNodePtr Rope::buildTree(std::vector<RopeNodePtr>& leaves)
                 break;
             }
 
-            auto node = std::make_shared<RopeNode>();
+            auto node = makeIntrusive<Node>();
             node->lChild = leaves[i * 2];
             node->rChild = leaves[i * 2 + 1];
-            node->weight = nodeAsString(node->lChild).length();
+            node->weight = nodeLength(node->lChild);
+            node->newlines = nodeNewlines(node->lChild) + nodeNewlines(node->rChild);
 
             leaves[i] = node;
         }
@@ -275,50 +1034,313 @@ RopeNodePtr Rope::buildTree(std::vector<RopeNodePtr>& leaves)
     return leaves.front();
 }
 
-RopeNodePtr Rope::copySubtree(RopeNodePtr node)
+template <typename RefCount>
+BasicRopeNodePtr<RefCount> BasicRope<RefCount>::copySubtree(NodePtr node)
 {
     if (node == nullptr)
         return nullptr;
 
-    RopeNodePtr newNode = std::make_shared<RopeNode>();
+    // Leaves are only modified in place while unshared, so copies can share them.
+    if (node->isLeaf())
+        return node;
+
+    NodePtr newNode = makeIntrusive<Node>();
 
     newNode->lChild = copySubtree(node->lChild);
     newNode->rChild = copySubtree(node->rChild);
     newNode->content = node->content;
     newNode->weight = node->weight;
+    newNode->newlines = node->newlines;
 
     return newNode; 
 }
 
-std::vector<RopeNodePtr> Rope::collectLeaves() const
+template <typename RefCount>
+std::vector<BasicRopeNodePtr<RefCount>> BasicRope<RefCount>::collectLeaves() const
+{
+    std::vector<NodePtr> leaves;
+    collectLeaves(root, leaves);
+    return leaves;
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::collectLeaves(const NodePtr& node, std::vector<NodePtr>& leaves)
+{
+    if (node == nullptr)
+        return;
+
+    if (node->isLeaf())
+    {
+        leaves.push_back(node);
+        return;
+    }
+
+    collectLeaves(node->lChild, leaves);
+    collectLeaves(node->rChild, leaves);
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::copyOnWrite()
 {
-    std::function<void(RopeNodePtr, std::vector<RopeNodePtr>&)> collect = [&](RopeNodePtr node, std::vector<RopeNodePtr>& leaves)
+    if (!root.unique())
     {
-        if (node == nullptr)
-            return;
+        root = copySubtree(root);
+        invalidateFinger();
+    }
+}
 
-        if (node->isLeaf())
+template <typename RefCount>
+bool BasicRope<RefCount>::fingerCovers(int index, bool inclusiveEnd) const
+{
+    if (finger.path.empty() || finger.root != root.get())
+        return false;
+
+    int end = finger.start + finger.path.back()->weight;
+
+    return index >= finger.start && (index < end || (inclusiveEnd && index == end));
+}
+
+template <typename RefCount>
+BasicRopeNode<RefCount>* BasicRope<RefCount>::seekLeaf(int index, bool preferLeft)
+{
+    finger.root = root.get();
+    finger.path.clear();
+    finger.start = 0;
+
+    Node* node = root.get();
+
+    while (!node->isLeaf())
+    {
+        finger.path.push_back(node);
+
+        bool goLeft = preferLeft ? index <= node->weight : index < node->weight;
+
+        if ((goLeft && node->lChild != nullptr) || node->rChild == nullptr)
+        {
+            node = node->lChild.get();
+        }
+        else
         {
-            leaves.push_back(node);
-            return;
+            index -= node->weight;
+            finger.start += node->weight;
+            node = node->rChild.get();
         }
+    }
 
-        collect(node->lChild, leaves);
-        collect(node->rChild, leaves);
-    };
+    finger.path.push_back(node);
 
-    std::vector<RopeNodePtr> leaves;
-    collect(root, leaves);
-    return leaves;
+    return node;
 }
 
-void Rope::copyOnWrite()
+template <typename RefCount>
+bool BasicRope<RefCount>::insertAtFinger(const std::string& str, int index)
 {
-    if (!root.unique())
-        root = copySubtree(root);
+    if (root == nullptr)
+        return false;
+
+    if (!fingerCovers(index, true))
+        seekLeaf(index, true);
+
+    Node* leaf = finger.path.back();
+
+    if (index < finger.start || index > finger.start + leaf->weight)
+        return false;
+
+    if (!fingerPathUnique())
+        return false;
+
+    int newlines = contentNewlines(str);
+
+    for (size_t i = 1; i < finger.path.size(); i++)
+    {
+        Node* parent = finger.path[i - 1];
+
+        if (parent->lChild.get() == finger.path[i])
+            parent->weight += str.length();
+
+        parent->newlines += newlines;
+    }
+
+    leaf->content.insert(index - finger.start, str);
+    leaf->weight = leaf->content.length();
+    leaf->newlines += newlines;
+
+    if (leaf->weight > MAX_LEAF_GROWTH)
+        splitFingerLeaf(index + str.length());
+
+    return true;
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::splitFingerLeaf(int cursor)
+{
+    // The leaf becomes a branch over its two halves. Ancestor weights and
+    // newline counts are unchanged, since the text below them is the same.
+    Node* node = finger.path.back();
+
+    int half = node->content.length() / 2;
+
+    node->lChild = makeLeaf(node->content.substr(0, half));
+    node->rChild = makeLeaf(node->content.substr(half));
+    node->weight = half;
+    node->content.clear();
+    node->content.shrink_to_fit();
+
+    if (cursor - finger.start <= half)
+    {
+        finger.path.push_back(node->lChild.get());
+    }
+    else
+    {
+        finger.start += half;
+        finger.path.push_back(node->rChild.get());
+    }
+
+    if (int(finger.path.size()) - 1 > maxDepth(length()))
+        rebuildFingerPath();
+}
+
+template <typename RefCount>
+int BasicRope<RefCount>::eraseAtFinger(int start, int end)
+{
+    if (root == nullptr)
+        return 0;
+
+    if (!fingerCovers(end - 1, false))
+        seekLeaf(end - 1, false);
+
+    Node* leaf = finger.path.back();
+
+    if (end - 1 < finger.start || end > finger.start + leaf->weight)
+        return 0;
+
+    if (!fingerPathUnique())
+        return 0;
+
+    int from = std::max(start - finger.start, 0);
+    int count = end - finger.start - from;
+    int newlines = countByte(leaf->content.data() + from, count, '\n');
+
+    for (size_t i = 1; i < finger.path.size(); i++)
+    {
+        Node* parent = finger.path[i - 1];
+
+        if (parent->lChild.get() == finger.path[i])
+            parent->weight -= count;
+
+        parent->newlines -= newlines;
+    }
+
+    leaf->content.erase(from, count);
+    leaf->weight = leaf->content.length();
+    leaf->newlines -= newlines;
+
+    if (leaf->weight < MAX_WEIGHT)
+        mergeFingerLeaf();
+
+    return count;
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::mergeFingerLeaf()
+{
+    // A short leaf left by an erase is folded into its parent, together with
+    // a sibling leaf, or dropped if it is empty. Either way the text below
+    // every ancestor is unchanged, so their weights stay as they are.
+    Node* leaf = finger.path.back();
+
+    if (finger.path.size() == 1)
+    {
+        if (leaf->weight == 0)
+        {
+            root = nullptr;
+            invalidateFinger();
+        }
+
+        return;
+    }
+
+    Node* parent = finger.path[finger.path.size() - 2];
+    bool isLeft = parent->lChild.get() == leaf;
+    const NodePtr& sibling = isLeft ? parent->rChild : parent->lChild;
+
+    if (leaf->weight == 0)
+    {
+        NodePtr& slot = finger.path.size() == 2 ? root : (finger.path[finger.path.size() - 3]->lChild.get() == parent ? finger.path[finger.path.size() - 3]->lChild : finger.path[finger.path.size() - 3]->rChild);
+        NodePtr replacement = sibling;
+
+        slot = std::move(replacement);
+    }
+    else if (sibling != nullptr && sibling->isLeaf() && leaf->weight + sibling->weight <= 2 * MAX_WEIGHT)
+    {
+        parent->content = isLeft ? leaf->content + sibling->content : sibling->content + leaf->content;
+        parent->weight = parent->content.length();
+        parent->lChild = nullptr;
+        parent->rChild = nullptr;
+    }
+    else
+    {
+        return;
+    }
+
+    invalidateFinger();
+}
+
+template <typename RefCount>
+bool BasicRope<RefCount>::fingerPathUnique() const
+{
+    // Nodes on the path are modified in place, which is only allowed when no
+    // other rope can observe them.
+    if (root.useCount() != 1)
+        return false;
+
+    for (size_t i = 1; i < finger.path.size(); i++)
+    {
+        Node* parent = finger.path[i - 1];
+        const NodePtr& child = parent->lChild.get() == finger.path[i] ? parent->lChild : parent->rChild;
+
+        if (child.useCount() != 1)
+            return false;
+    }
+
+    return true;
+}
+
+template <typename RefCount>
+void BasicRope<RefCount>::rebuildFingerPath()
+{
+    // Like a scapegoat tree, rebuild only the lowest subtree on the path that
+    // is too deep for its length. Its size is proportional to the inserts that
+    // deepened it, so repeated local splits cost amortized O(log n).
+    int leafDepth = finger.path.size() - 1;
+
+    for (int i = leafDepth - 1; i >= 0; i--)
+    {
+        Node* node = finger.path[i];
+
+        if (leafDepth - i <= maxDepth(node->weight + nodeLength(node->rChild)))
+            continue;
+
+        NodePtr& slot = i == 0 ? root : (finger.path[i - 1]->lChild.get() == node ? finger.path[i - 1]->lChild : finger.path[i - 1]->rChild);
+
+        std::vector<NodePtr> leaves;
+        collectLeaves(slot, leaves);
+        slot = buildTree(leaves);
+
+        break;
+    }
+
+    invalidateFinger();
+}
+
+template <typename RefCount>
+int BasicRope<RefCount>::maxDepth(int length)
+{
+    return 2 * std::ceil(std::log2(length / float(MAX_WEIGHT) + 1)) + 2;
 }
 
-std::string Rope::nodeAsString(RopeNodePtr node) const
+template <typename RefCount>
+std::string BasicRope<RefCount>::nodeAsString(NodePtr node) const
 {
     if (node == nullptr)
         return "";
@@ -329,7 +1351,20 @@ std::string Rope::nodeAsString(RopeNodePtr node) const
     return nodeAsString(node->lChild) + nodeAsString(node->rChild);
 }
 
-int Rope::nodeDepth(const RopeNodePtr node) const
+template <typename RefCount>
+int BasicRope<RefCount>::nodeNewlines(const NodePtr& node)
+{
+    return node == nullptr ? 0 : node->newlines;
+}
+
+template <typename RefCount>
+int BasicRope<RefCount>::contentNewlines(const std::string& content)
+{
+    return countByte(content.data(), content.length(), '\n');
+}
+
+template <typename RefCount>
+int BasicRope<RefCount>::nodeDepth(const NodePtr node) const
 {
     if (node == nullptr)
         return 0;
@@ -340,7 +1375,8 @@ int Rope::nodeDepth(const RopeNodePtr node) const
     return 1 + std::max(nodeDepth(node->lChild), nodeDepth(node->rChild));
 }
 
-int Rope::nodeLength(const RopeNodePtr node) const
+template <typename RefCount>
+int BasicRope<RefCount>::nodeLength(const NodePtr node) const
 {
     if (node == nullptr)
         return 0;
@@ -348,10 +1384,12 @@ int Rope::nodeLength(const RopeNodePtr node) const
     if (node->isLeaf())
         return node->content.length();
 
-    return nodeLength(node->lChild) + nodeLength(node->rChild);
+    // Weight is the length of the left subtree, so only the right spine is walked.
+    return node->weight + nodeLength(node->rChild);
 }
 
-void Rope::printBranches(const RopeNodePtr node, const std::string& prefix, bool isLeft) const
+template <typename RefCount>
+void BasicRope<RefCount>::printBranches(const NodePtr node, const std::string& prefix, bool isLeft) const
 {
     if (node == nullptr)
     {
@@ -381,3 +1419,6 @@ void Rope::printBranches(const RopeNodePtr node, const std::string& prefix, bool
     if (node->rChild)
         printBranches(node->rChild, childPrefix, false);
 }
+
+template class BasicRope<AtomicRefCount>;
+template class BasicRope<PlainRefCount>;
@@ -0,0 +1,206 @@
+#include "rope_pool.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+template <typename RefCount>
+size_t BasicRopePool<RefCount>::BranchKeyHash::operator()(const BranchKey& key) const
+{
+    size_t hash = std::hash<const Node*>()(key.lChild);
+
+    hash ^= std::hash<const Node*>()(key.rChild) + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<int>()(key.weight) + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+
+    return hash;
+}
+
+// Bytes the content of a leaf allocates outside the node. Short strings live in
+// their own buffer inside the node, and allocate nothing.
+template <typename Node>
+static size_t heapBytes(const Node* leaf)
+{
+    auto data = reinterpret_cast<std::uintptr_t>(leaf->content.data());
+    auto node = reinterpret_cast<std::uintptr_t>(leaf);
+
+    if (data >= node && data < node + sizeof(Node))
+        return 0;
+
+    return leaf->content.capacity();
+}
+
+template <typename RefCount>
+BasicRopePool<RefCount>& BasicRopePool<RefCount>::global()
+{
+    if constexpr (std::is_same_v<RefCount, PlainRefCount>)
+    {
+        static thread_local BasicRopePool pool;
+        return pool;
+    }
+    else
+    {
+        static BasicRopePool pool;
+        return pool;
+    }
+}
+
+template <typename RefCount>
+BasicRopeNodePtr<RefCount> BasicRopePool<RefCount>::intern(const NodePtr& node)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return internNode(node);
+}
+
+template <typename RefCount>
+void BasicRopePool<RefCount>::purge()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Branches first, since they keep their children alive. Dropping a branch
+    // can free a child visited earlier, so repeat until nothing changes.
+    size_t before;
+
+    do
+    {
+        before = branches.size();
+
+        for (auto it = branches.begin(); it != branches.end();)
+            it = it->second.useCount() == 1 ? branches.erase(it) : std::next(it);
+    }
+    while (branches.size() != before);
+
+    for (auto it = leaves.begin(); it != leaves.end();)
+        it = it->second.useCount() == 1 ? leaves.erase(it) : std::next(it);
+}
+
+template <typename RefCount>
+typename BasicRopePool<RefCount>::Stats BasicRopePool<RefCount>::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    Stats result;
+
+    result.uniqueLeaves = leaves.size();
+    result.uniqueBranches = branches.size();
+    result.bytesSaved = countBytesSaved();
+
+    return result;
+}
+
+template <typename RefCount>
+size_t BasicRopePool<RefCount>::countBytesSaved() const
+{
+    // References from outside the pool are those not held by the pool itself
+    // or by pooled branches.
+    std::unordered_map<const Node*, size_t> pooledParents;
+
+    for (const auto& [key, branch] : branches)
+    {
+        pooledParents[key.lChild]++;
+        pooledParents[key.rChild]++;
+    }
+
+    auto outsideReferences = [&](const NodePtr& node) -> size_t
+    {
+        auto it = pooledParents.find(node.get());
+        return node.useCount() - 1 - (it == pooledParents.end() ? 0 : it->second);
+    };
+
+    // Order branches so that parents come before their children. Pooled
+    // branches only have pooled children.
+    std::vector<const Node*> order;
+    std::unordered_set<const Node*> visited;
+
+    std::function<void(const Node*)> visit = [&](const Node* node)
+    {
+        if (node == nullptr || node->isLeaf() || !visited.insert(node).second)
+            return;
+
+        visit(node->lChild.get());
+        visit(node->rChild.get());
+        order.push_back(node);
+    };
+
+    for (const auto& [key, branch] : branches)
+        visit(branch.get());
+
+    // Without sharing, every copy of a parent would hold its own copy of each
+    // child, so copies are passed down from parent to child.
+    std::unordered_map<const Node*, size_t> copies;
+    size_t saved = 0;
+
+    for (const auto& [key, branch] : branches)
+        copies[branch.get()] = outsideReferences(branch);
+
+    for (auto it = order.rbegin(); it != order.rend(); ++it)
+    {
+        size_t count = copies[*it];
+
+        if (count > 1)
+            saved += (count - 1) * sizeof(Node);
+
+        if ((*it)->lChild != nullptr)
+            copies[(*it)->lChild.get()] += count;
+
+        if ((*it)->rChild != nullptr)
+            copies[(*it)->rChild.get()] += count;
+    }
+
+    for (const auto& [content, leaf] : leaves)
+    {
+        size_t count = copies[leaf.get()] + outsideReferences(leaf);
+
+        if (count > 1)
+            saved += (count - 1) * (sizeof(Node) + heapBytes(leaf.get()));
+    }
+
+    return saved;
+}
+
+template <typename RefCount>
+BasicRopeNodePtr<RefCount> BasicRopePool<RefCount>::internNode(const NodePtr& node)
+{
+    if (node == nullptr)
+        return nullptr;
+
+    if (node->isLeaf())
+    {
+        auto it = leaves.find(node->content);
+
+        if (it != leaves.end())
+            return it->second;
+
+        leaves.emplace(node->content, node);
+        return node;
+    }
+
+    auto lChild = internNode(node->lChild);
+    auto rChild = internNode(node->rChild);
+
+    BranchKey key = {lChild.get(), rChild.get(), node->weight};
+    auto it = branches.find(key);
+
+    if (it != branches.end())
+        return it->second;
+
+    // The node itself may be shared with ropes that have not been interned, so
+    // it is only pooled as is if its children are already the pooled ones.
+    NodePtr pooled = node;
+
+    if (lChild != node->lChild || rChild != node->rChild)
+    {
+        pooled = makeIntrusive<Node>(*node);
+        pooled->lChild = lChild;
+        pooled->rChild = rChild;
+    }
+
+    branches.emplace(key, pooled);
+    return pooled;
+}
+
+template class BasicRopePool<AtomicRefCount>;
+template class BasicRopePool<PlainRefCount>;
@@ -0,0 +1,293 @@
+#include <gtest/gtest.h>
+#include <btree_rope.hpp>
+
+#include <algorithm>
+#include <random>
+
+static std::string makeText(int length)
+{
+    std::string text;
+
+    for (int i = 0; i < length; i++)
+        text += 'a' + (i * 7 + i / 13) % 26;
+
+    return text;
+}
+
+static int nodeDepth(const BTreeNodePtr& node)
+{
+    return node == nullptr ? 0 : node->height + 1;
+}
+
+TEST(BTreeRopeConstruct, Content)
+{
+    std::string text = makeText(100000);
+    BTreeRope rope(text);
+
+    ASSERT_EQ(rope.asString(), text);
+    ASSERT_EQ(rope.length(), text.length());
+}
+
+TEST(BTreeRopeConstruct, EmptyRope)
+{
+    BTreeRope rope("");
+
+    ASSERT_EQ(rope.length(), 0);
+    ASSERT_EQ(rope.rootNode(), nullptr);
+}
+
+TEST(BTreeRopeConstruct, ShallowTree)
+{
+    BTreeRope rope(makeText(1000000));
+
+    // 1000 leaves fit in three levels of 16-way branches.
+    ASSERT_LE(nodeDepth(rope.rootNode()), 4);
+}
+
+TEST(BTreeRopeAt, CorrectChar)
+{
+    std::string text = makeText(50000);
+    BTreeRope rope(text);
+
+    for (int i = 0; i < text.length(); i++)
+        ASSERT_EQ(rope.at(i), text[i]);
+
+    ASSERT_EQ(rope.at(-1), '\0');
+    ASSERT_EQ(rope.at(text.length()), '\0');
+}
+
+TEST(BTreeRopeSplit, NoLettersLost)
+{
+    std::string text = makeText(20000);
+    BTreeRope rope(text);
+
+    for (int i = 0; i <= text.length(); i += 97)
+    {
+        auto [left, right] = rope.split(i);
+
+        ASSERT_EQ(left.asString(), text.substr(0, i));
+        ASSERT_EQ(right.asString(), text.substr(i));
+    }
+
+    ASSERT_EQ(rope.asString(), text);
+}
+
+TEST(BTreeRopeSplit, OutOfBoundIndex)
+{
+    BTreeRope rope("ABCDEF");
+
+    auto [left, right] = rope.split(7);
+
+    ASSERT_EQ(left.rootNode(), nullptr);
+    ASSERT_EQ(right.rootNode(), nullptr);
+}
+
+TEST(BTreeRopeConcat, Repeat)
+{
+    std::string text = makeText(5000);
+    BTreeRope rope;
+
+    for (const char& c : text)
+        rope.concat(BTreeRope(c));
+
+    ASSERT_EQ(rope.asString(), text);
+    ASSERT_LE(nodeDepth(rope.rootNode()), 3);
+}
+
+TEST(BTreeRopeInsert, OutOfBounds)
+{
+    BTreeRope rope("ABC");
+
+    ASSERT_THROW(rope.insert(BTreeRope("X"), 4), std::out_of_range);
+    ASSERT_THROW(rope.insert(BTreeRope("X"), -1), std::out_of_range);
+}
+
+TEST(BTreeRopeEdit, MatchesString)
+{
+    std::mt19937 rng(42);
+    std::string text = makeText(30000);
+    BTreeRope rope(text);
+
+    for (int i = 0; i < 500; i++)
+    {
+        int pos = rng() % (text.length() + 1);
+
+        if (rng() % 2 == 0)
+        {
+            std::string piece = makeText(rng() % 3000);
+
+            rope.insert(BTreeRope(piece), pos);
+            text.insert(pos, piece);
+        }
+        else
+        {
+            int end = std::min<int>(text.length(), pos + rng() % 3000);
+
+            rope.erase(pos, end);
+            text.erase(pos, end - pos);
+        }
+
+        ASSERT_EQ(rope.length(), text.length());
+    }
+
+    ASSERT_EQ(rope.asString(), text);
+
+    for (int i = 0; i < text.length(); i += 31)
+        ASSERT_EQ(rope.at(i), text[i]);
+}
+
+TEST(BTreeRopeSubString, CorrectString)
+{
+    std::string text = makeText(10000);
+    BTreeRope rope(text);
+
+    for (int i = 0; i < text.length(); i += 499)
+        for (int j = i; j < text.length(); j += 1201)
+            ASSERT_EQ(rope.subString(i, j).asString(), text.substr(i, j - i));
+}
+
+TEST(BTreeRopeCopy, SeparatelyModifiable)
+{
+    BTreeRope rope("123");
+    BTreeRope copy(rope);
+
+    rope.concat("789");
+    copy.insert("456", 3);
+
+    ASSERT_EQ(rope.asString(), "123789");
+    ASSERT_EQ(copy.asString(), "123456");
+}
+
+TEST(BTreeRopeScan, Count)
+{
+    std::string text = makeText(100000);
+    BTreeRope rope(text);
+
+    ASSERT_EQ(rope.count('q'), std::count(text.begin(), text.end(), 'q'));
+    ASSERT_EQ(rope.count('#'), 0);
+}
+
+TEST(BTreeRopeScan, Find)
+{
+    std::string text = makeText(100000);
+    BTreeRope rope(text);
+
+    for (int start : {-5, 0, 1, 1023, 1024, 50000, 99999})
+        ASSERT_EQ(rope.find('z', start), text.find('z', std::max(start, 0)));
+
+    ASSERT_EQ(rope.find('#'), -1);
+    ASSERT_EQ(rope.find('a', 100000), -1);
+}
+
+TEST(BTreeRopeCompression, ColdLeavesCompressed)
+{
+    std::string text = makeText(200000);
+    BTreeRope rope(text);
+    rope.enableCompression();
+
+    size_t before = rope.leafBytes();
+
+    // New leaves count as recently used, so the first sweep only ages them.
+    ASSERT_EQ(rope.compressColdLeaves(), 0);
+    ASSERT_GT(rope.compressColdLeaves(), 0);
+    ASSERT_LT(rope.leafBytes(), before / 2);
+
+    for (int i = 0; i < text.length(); i += 7)
+        ASSERT_EQ(rope.at(i), text[i]);
+
+    ASSERT_EQ(rope.asString(), text);
+}
+
+TEST(BTreeRopeCompression, RecentlyReadLeavesKept)
+{
+    std::string text = makeText(200000);
+    BTreeRope rope(text);
+    rope.enableCompression();
+
+    rope.compressColdLeaves();
+    rope.at(100);
+
+    int compressed = rope.compressColdLeaves();
+
+    ASSERT_GT(compressed, 0);
+    ASSERT_EQ(rope.compressColdLeaves(), 1);
+}
+
+TEST(BTreeRopeCompression, WarmLeavesRestored)
+{
+    std::string text = makeText(200000);
+    BTreeRope rope(text);
+    rope.enableCompression();
+
+    rope.compressColdLeaves();
+    rope.compressColdLeaves();
+
+    size_t compressedBytes = rope.leafBytes();
+
+    for (int i = 0; i < text.length(); i += 101)
+        ASSERT_EQ(rope.at(i), text[i]);
+
+    ASSERT_EQ(rope.compressColdLeaves(), 0);
+    ASSERT_GT(rope.leafBytes(), compressedBytes * 2);
+    ASSERT_EQ(rope.asString(), text);
+
+    // Restored leaves are cold again unless read before the next sweep.
+    ASSERT_GT(rope.compressColdLeaves(), 0);
+    ASSERT_EQ(rope.leafBytes(), compressedBytes);
+}
+
+TEST(BTreeRopeCompression, EditCompressedRope)
+{
+    std::string text = makeText(100000);
+    BTreeRope rope(text);
+    rope.enableCompression();
+    BTreeRope copy(rope);
+
+    rope.compressColdLeaves();
+    rope.compressColdLeaves();
+
+    rope.insert(BTreeRope("inserted"), 5000);
+    text.insert(5000, "inserted");
+    rope.erase(60000, 61000);
+    text.erase(60000, 1000);
+
+    auto [left, right] = rope.split(30000);
+
+    ASSERT_EQ(left.asString(), text.substr(0, 30000));
+    ASSERT_EQ(right.asString(), text.substr(30000));
+    ASSERT_EQ(copy.asString(), makeText(100000));
+}
+
+TEST(BTreeRopeCompression, DisabledByDefault)
+{
+    std::string text = makeText(200000);
+    BTreeRope rope(text);
+
+    size_t before = rope.leafBytes();
+
+    ASSERT_EQ(rope.compressColdLeaves(), 0);
+    ASSERT_EQ(rope.compressColdLeaves(), 0);
+    ASSERT_EQ(rope.leafBytes(), before);
+}
+
+TEST(BTreeRopeCompression, ReadLeavesCompressedByCopy)
+{
+    std::string text = makeText(200000);
+    BTreeRope rope(text);
+    BTreeRope copy(rope);
+
+    copy.enableCompression();
+    copy.compressColdLeaves();
+    copy.compressColdLeaves();
+
+    size_t compressedBytes = copy.leafBytes();
+
+    // The leaves are shared, so the rope without compression now reads
+    // compressed leaves, but without marking them warm.
+    for (int i = 0; i < text.length(); i += 997)
+        ASSERT_EQ(rope.at(i), text[i]);
+
+    ASSERT_EQ(copy.compressColdLeaves(), 0);
+    ASSERT_EQ(copy.leafBytes(), compressedBytes);
+    ASSERT_EQ(rope.asString(), text);
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include <byte_scan.hpp>
+
+#include <algorithm>
+#include <string>
+
+// Mixed ASCII and multi-byte UTF-8 input, long enough to cover the vector
+// loops and the scalar tails at every offset.
+static std::string makeInput()
+{
+    std::string text;
+
+    for (int i = 0; i < 300; i++)
+    {
+        text += "line ";
+        text += std::to_string(i);
+        text += (i % 3 == 0) ? " \xc3\xa5\xc3\xa4\xc3\xb6" : " \xe2\x82\xac";
+        text += '\n';
+    }
+
+    return text;
+}
+
+TEST(ByteScan, CountByte)
+{
+    std::string text = makeInput();
+
+    for (int start = 0; start < 40; start++)
+        for (int length : {0, 1, 15, 16, 17, 31, 32, 33, 100, 1000})
+        {
+            std::string part = text.substr(start, length);
+            int expected = std::count(part.begin(), part.end(), '\n');
+
+            ASSERT_EQ(countByte(part.data(), part.length(), '\n'), expected);
+        }
+}
+
+TEST(ByteScan, FindByte)
+{
+    std::string text = makeInput();
+
+    for (int start = 0; start < 200; start++)
+    {
+        std::string part = text.substr(start, 150);
+        int expected = part.find('\n');
+
+        ASSERT_EQ(findByte(part.data(), part.length(), '\n'), expected == std::string::npos ? -1 : expected);
+        ASSERT_EQ(findByte(part.data(), part.length(), '#'), -1);
+    }
+}
+
+TEST(ByteScan, FindLastByte)
+{
+    std::string text = makeInput();
+
+    for (int length = 0; length < 200; length++)
+    {
+        std::string part = text.substr(0, length);
+        int expected = part.rfind('\n');
+
+        ASSERT_EQ(findLastByte(part.data(), part.length(), '\n'), expected == std::string::npos ? -1 : expected);
+    }
+}
+
+TEST(ByteScan, CountUtf8LeadBytes)
+{
+    std::string text = makeInput();
+
+    for (int length = 0; length < 300; length++)
+    {
+        int expected = 0;
+
+        for (int i = 0; i < length; i++)
+            expected += (text[i] & 0xC0) != 0x80;
+
+        ASSERT_EQ(countUtf8LeadBytes(text.data(), length), expected);
+    }
+}
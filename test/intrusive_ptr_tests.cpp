@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include <intrusive_ptr.hpp>
+
+template <typename RefCount>
+struct Counted
+{
+    RefCount refCount;
+    int* destroyed;
+
+    Counted(int* destroyed) : destroyed(destroyed) {}
+    Counted(const Counted& other) = default;
+    ~Counted() { (*destroyed)++; }
+};
+
+template <typename RefCount>
+class IntrusivePtrTest : public testing::Test {};
+
+using RefCountPolicies = testing::Types<AtomicRefCount, PlainRefCount>;
+TYPED_TEST_SUITE(IntrusivePtrTest, RefCountPolicies);
+
+TYPED_TEST(IntrusivePtrTest, CopyAndRelease)
+{
+    int destroyed = 0;
+
+    {
+        auto ptr = makeIntrusive<Counted<TypeParam>>(&destroyed);
+        ASSERT_TRUE(ptr.unique());
+
+        {
+            auto copy = ptr;
+            ASSERT_EQ(ptr.useCount(), 2);
+            ASSERT_EQ(copy, ptr);
+        }
+
+        ASSERT_EQ(ptr.useCount(), 1);
+        ASSERT_EQ(destroyed, 0);
+    }
+
+    ASSERT_EQ(destroyed, 1);
+}
+
+TYPED_TEST(IntrusivePtrTest, Move)
+{
+    int destroyed = 0;
+
+    auto ptr = makeIntrusive<Counted<TypeParam>>(&destroyed);
+    auto moved = std::move(ptr);
+
+    ASSERT_EQ(ptr, nullptr);
+    ASSERT_EQ(moved.useCount(), 1);
+
+    moved = nullptr;
+
+    ASSERT_EQ(destroyed, 1);
+}
+
+TYPED_TEST(IntrusivePtrTest, ObjectCopyStartsUnreferenced)
+{
+    int destroyed = 0;
+
+    auto ptr = makeIntrusive<Counted<TypeParam>>(&destroyed);
+    auto other = ptr;
+    auto copy = makeIntrusive<Counted<TypeParam>>(*ptr);
+
+    ASSERT_EQ(copy.useCount(), 1);
+    ASSERT_EQ(ptr.useCount(), 2);
+}
@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include <lz.hpp>
+
+#include <random>
+
+static void expectRoundTrip(const std::string& input)
+{
+    std::string packed = lzCompress(input);
+
+    ASSERT_EQ(lzDecompress(packed, input.length()), input);
+}
+
+TEST(Lz, Empty)
+{
+    expectRoundTrip("");
+}
+
+TEST(Lz, ShortInputs)
+{
+    expectRoundTrip("a");
+    expectRoundTrip("abc");
+    expectRoundTrip("abcd");
+    expectRoundTrip("abcdabcd");
+}
+
+TEST(Lz, RepetitiveInputShrinks)
+{
+    std::string input;
+
+    for (int i = 0; i < 200; i++)
+        input += "2024-01-01 INFO request handled\n";
+
+    std::string packed = lzCompress(input);
+
+    ASSERT_LT(packed.length(), input.length() / 10);
+    ASSERT_EQ(lzDecompress(packed, input.length()), input);
+}
+
+TEST(Lz, OverlappingMatch)
+{
+    expectRoundTrip(std::string(1000, 'z'));
+    expectRoundTrip("ab" + std::string(300, 'x') + "ab");
+}
+
+TEST(Lz, RandomInput)
+{
+    std::mt19937 rng(7);
+
+    for (int size : {1, 127, 128, 129, 1000, 70000})
+    {
+        std::string input;
+
+        for (int i = 0; i < size; i++)
+            input += char(rng() % 4 == 0 ? rng() : 'a' + rng() % 3);
+
+        expectRoundTrip(input);
+    }
+}
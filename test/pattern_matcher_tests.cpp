@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <pattern_matcher.hpp>
+
+#include <algorithm>
+
+using Match = PatternMatcher::Match;
+
+static std::vector<Match> naiveMatches(const std::string& text, const std::vector<std::string>& patterns, int start, int end)
+{
+    std::vector<Match> matches;
+
+    for (int i = start; i < end; i++)
+        for (int id = 0; id < patterns.size(); id++)
+            if (!patterns[id].empty() && i + patterns[id].length() <= end && text.compare(i, patterns[id].length(), patterns[id]) == 0)
+                matches.push_back({id, i});
+
+    return matches;
+}
+
+static void sortMatches(std::vector<Match>& matches)
+{
+    std::sort(matches.begin(), matches.end(), [](const Match& a, const Match& b)
+    {
+        return a.offset != b.offset ? a.offset < b.offset : a.pattern < b.pattern;
+    });
+}
+
+static const std::string TEXT = "she sells sea shells by the sea shore; he sees his shears";
+static const std::vector<std::string> PATTERNS = {"he", "she", "his", "hers", "sea", "shells", "s", ""};
+
+TEST(PatternMatcher, MatchesAcrossLeaves)
+{
+    PatternMatcher matcher(PATTERNS);
+    Rope rope(TEXT);
+
+    auto matches = matcher.scan(rope);
+    auto expected = naiveMatches(TEXT, PATTERNS, 0, TEXT.length());
+
+    sortMatches(matches);
+    sortMatches(expected);
+
+    ASSERT_EQ(matches, expected);
+}
+
+TEST(PatternMatcher, Range)
+{
+    PatternMatcher matcher(PATTERNS);
+    Rope rope(TEXT);
+
+    for (int start = 0; start < TEXT.length(); start += 3)
+        for (int end = start; end <= TEXT.length(); end += 7)
+        {
+            auto matches = matcher.scan(rope, start, end);
+            auto expected = naiveMatches(TEXT, PATTERNS, start, end);
+
+            sortMatches(matches);
+            sortMatches(expected);
+
+            ASSERT_EQ(matches, expected);
+        }
+}
+
+TEST(PatternMatcher, RangeOutOfBounds)
+{
+    PatternMatcher matcher({"abc"});
+    Rope rope("xxabcxx");
+
+    ASSERT_EQ(matcher.scan(rope, -2), (std::vector<PatternMatcher::Match>{{0, 2}}));
+    ASSERT_EQ(matcher.scan(rope, -2, 100), (std::vector<PatternMatcher::Match>{{0, 2}}));
+    ASSERT_TRUE(matcher.scan(rope, 10).empty());
+}
+
+TEST(PatternMatcher, ResumeAfterAppend)
+{
+    PatternMatcher matcher({"needle"});
+    Rope rope("hay hay nee");
+
+    PatternMatcher::State state;
+    std::vector<Match> matches;
+
+    matcher.scan(rope, state, rope.length(), matches);
+    ASSERT_TRUE(matches.empty());
+
+    rope.concat(Rope("dle hay needle"));
+    matcher.scan(rope, state, rope.length(), matches);
+
+    ASSERT_EQ(matches, (std::vector<Match>{{0, 8}, {0, 19}}));
+    ASSERT_EQ(state.offset, rope.length());
+}
+
+TEST(PatternMatcher, DuplicatePatterns)
+{
+    PatternMatcher matcher({"ab", "ab"});
+
+    auto matches = matcher.scan(Rope("xabx"));
+    sortMatches(matches);
+
+    ASSERT_EQ(matches, (std::vector<Match>{{0, 1}, {1, 1}}));
+}
+
+TEST(PatternMatcher, LocalRope)
+{
+    PatternMatcher matcher(PATTERNS);
+
+    auto matches = matcher.scan(LocalRope(TEXT));
+    auto expected = naiveMatches(TEXT, PATTERNS, 0, TEXT.length());
+
+    sortMatches(matches);
+    sortMatches(expected);
+
+    ASSERT_EQ(matches, expected);
+}
@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+#include <rope.hpp>
+#include <rope_pool.hpp>
+
+#include <thread>
+
+static const std::string HEADER = "2024-01-01 12:00:00 INFO service started on port 8080\n";
+
+TEST(RopePool, IdenticalRopesShareRoot)
+{
+    RopePool pool;
+
+    Rope first(HEADER + HEADER);
+    Rope second(HEADER + HEADER);
+
+    first.intern(pool);
+    second.intern(pool);
+
+    ASSERT_EQ(first.rootNode(), second.rootNode());
+    ASSERT_EQ(first.asString(), HEADER + HEADER);
+    ASSERT_GT(pool.stats().bytesSaved, 0);
+}
+
+TEST(RopePool, RepeatedLeavesStoredOnce)
+{
+    RopePool pool;
+
+    Rope rope(std::string(1000, 'x'));
+    rope.intern(pool);
+
+    auto stats = pool.stats();
+
+    ASSERT_EQ(stats.uniqueLeaves, 1);
+    ASSERT_EQ(rope.asString(), std::string(1000, 'x'));
+}
+
+TEST(RopePool, InternedRopesSeparatelyModifiable)
+{
+    RopePool pool;
+
+    Rope first(HEADER);
+    Rope second(HEADER);
+
+    first.intern(pool);
+    second.intern(pool);
+
+    first.insert(Rope("X"), 10);
+    second.erase(0, 5);
+
+    ASSERT_EQ(first.asString(), HEADER.substr(0, 10) + "X" + HEADER.substr(10));
+    ASSERT_EQ(second.asString(), HEADER.substr(5));
+}
+
+TEST(RopePool, PurgeDropsUnusedNodes)
+{
+    RopePool pool;
+
+    {
+        Rope rope(HEADER);
+        rope.intern(pool);
+    }
+
+    Rope kept("kept");
+    kept.intern(pool);
+
+    pool.purge();
+
+    auto stats = pool.stats();
+
+    ASSERT_EQ(stats.uniqueLeaves, 1);
+    ASSERT_EQ(stats.uniqueBranches, 0);
+}
+
+TEST(RopePool, BytesSavedCountsLiveSharing)
+{
+    RopePool pool;
+
+    {
+        Rope first(HEADER);
+        Rope second(HEADER);
+
+        first.intern(pool);
+        second.intern(pool);
+
+        ASSERT_GT(pool.stats().bytesSaved, 0);
+    }
+
+    // Nothing refers to the pooled nodes anymore, so nothing is saved.
+    ASSERT_EQ(pool.stats().bytesSaved, 0);
+
+    Rope unique("unique text");
+    unique.intern(pool);
+
+    ASSERT_EQ(pool.stats().bytesSaved, 0);
+}
+
+TEST(RopePool, BytesSavedMatchesDuplicateNodes)
+{
+    RopePool pool;
+
+    // 200 equal leaves under 199 branches. The leaves are short enough to be
+    // held inside their nodes.
+    Rope rope(std::string(1000, 'x'));
+    rope.intern(pool);
+
+    auto stats = pool.stats();
+
+    ASSERT_EQ(stats.uniqueLeaves, 1);
+    ASSERT_EQ(stats.bytesSaved, 199 * sizeof(RopeNode) + (199 - stats.uniqueBranches) * sizeof(RopeNode));
+}
+
+TEST(RopePool, BytesSavedCountsLongLeafContent)
+{
+    RopePool pool;
+
+    // Typing grows a leaf past the short string buffer.
+    std::string text = "abcde";
+    Rope first(text);
+    Rope second(text);
+
+    for (int i = 0; i < 15; i++)
+    {
+        first.insert(Rope('x'), first.length());
+        second.insert(Rope('x'), second.length());
+    }
+
+    ASSERT_TRUE(first.rootNode()->isLeaf());
+    size_t capacity = first.rootNode()->content.capacity();
+
+    first.intern(pool);
+    second.intern(pool);
+
+    ASSERT_EQ(pool.stats().bytesSaved, sizeof(RopeNode) + capacity);
+}
+
+TEST(RopePool, BytesSavedIgnoresDuplicatesStillInUse)
+{
+    RopePool pool;
+
+    Rope first(HEADER);
+    Rope second(HEADER);
+    Rope copy(second);
+
+    first.intern(pool);
+    second.intern(pool);
+
+    size_t shared = pool.stats().bytesSaved;
+
+    // copy still holds second's original nodes, so dropping second's
+    // reference to the pooled ones loses exactly that sharing.
+    second = Rope();
+
+    ASSERT_GT(shared, 0);
+    ASSERT_EQ(pool.stats().bytesSaved, 0);
+    ASSERT_EQ(copy.asString(), HEADER);
+}
+
+TEST(RopePool, LocalRopes)
+{
+    LocalRopePool pool;
+
+    LocalRope first(HEADER + HEADER);
+    LocalRope second(HEADER + HEADER);
+
+    first.intern(pool);
+    second.intern(pool);
+
+    ASSERT_EQ(first.rootNode(), second.rootNode());
+    ASSERT_GT(pool.stats().bytesSaved, 0);
+
+    second.erase(0, 5);
+
+    ASSERT_EQ(first.asString(), HEADER + HEADER);
+    ASSERT_EQ(second.asString(), (HEADER + HEADER).substr(5));
+}
+
+TEST(RopePool, LocalGlobalPoolPerThread)
+{
+    LocalRopePool* mainPool = &LocalRopePool::global();
+    LocalRopePool* threadPool = nullptr;
+
+    std::thread thread([&] { threadPool = &LocalRopePool::global(); });
+    thread.join();
+
+    ASSERT_NE(mainPool, threadPool);
+}
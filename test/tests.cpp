@@ -1,6 +1,14 @@
 #include <gtest/gtest.h>
 #include <rope.hpp>
 
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
 const std::string LOREM = "Lorem ipsum odor amet, consectetuer adipiscing elit. Ultrices nostra curae mi dui litora lacinia egestas hac. Pharetra tristique arcu blandit montes rhoncus. Mi venenatis blandit dignissim; gravida non amet tempor curabitur. Pellentesque natoque sapien posuere imperdiet praesent cursus lacinia. Sit rhoncus fusce rhoncus hendrerit scelerisque etiam. Ad curabitur litora taciti, rhoncus natoque eros quis. Cras morbi class pretium congue mollis purus blandit gravida volutpat. \
     Rutrum dolor mollis nascetur elit ac molestie ullamcorper rutrum vulputate. Ut volutpat senectus neque cubilia turpis vulputate. Massa purus euismod elementum at et nunc eget. Rutrum finibus penatibus himenaeos lacinia litora et. Pellentesque cubilia aenean diam etiam habitasse justo mollis. Lobortis adipiscing taciti faucibus ex primis lectus lectus. Cursus sociosqu malesuada vivamus lobortis eget curabitur. \
     Ultricies condimentum aliquet potenti fames viverra. Scelerisque porttitor bibendum suspendisse; nunc duis eget. Eleifend suspendisse curabitur metus natoque inceptos viverra rutrum aliquam. Orci neque venenatis feugiat malesuada pellentesque tincidunt. Litora euismod dui dui maximus etiam semper erat magnis inceptos. Hendrerit diam accumsan tempus dapibus; cras mollis. Quisque ut vestibulum dictum risus ridiculus vehicula natoque sociosqu hendrerit. \
@@ -50,7 +58,7 @@ TEST(RopeRebalance, NewlyCreatedUnchanged)
     Rope newRope(rope);
     rope.rebalance();
 
-    ASSERT_EQ(rope, newRope);
+    ASSERT_TRUE(rope.sameStructure(newRope));
 }
 
 static bool splitInit = false;
@@ -453,3 +461,745 @@ TEST(RopeErase, SingleCharacter) {
 
     ASSERT_EQ(single.asString(), "");
 }
+
+TEST(RopeFinger, ConsecutiveInserts)
+{
+    Rope rope(SHORT_STR_1);
+    std::string expected = SHORT_STR_1;
+
+    for (int i = 0; i < SHORT_STR_2.length(); i++)
+    {
+        rope.insert(Rope(SHORT_STR_2[i]), 10 + i);
+        expected.insert(10 + i, 1, SHORT_STR_2[i]);
+
+        ASSERT_EQ(rope.at(10 + i), SHORT_STR_2[i]);
+    }
+
+    ASSERT_EQ(rope.asString(), expected);
+    ASSERT_EQ(rope.length(), expected.length());
+
+    for (int i = 0; i < expected.length(); i++)
+        ASSERT_EQ(rope.at(i), expected.at(i));
+}
+
+TEST(RopeFinger, CopyNotModified)
+{
+    Rope rope(SHORT_STR_1);
+    rope.at(3);
+
+    Rope copy(rope);
+    rope.insert(Rope('X'), 3);
+    copy.insert(Rope('Y'), 4);
+
+    ASSERT_EQ(rope.asString(), SHORT_STR_1.substr(0, 3) + "X" + SHORT_STR_1.substr(3));
+    ASSERT_EQ(copy.asString(), SHORT_STR_1.substr(0, 4) + "Y" + SHORT_STR_1.substr(4));
+}
+
+TEST(RopeFinger, SplitPartsNotModified)
+{
+    Rope rope(SHORT_STR_1);
+    rope.insert(Rope('X'), 7);
+
+    auto [left, right] = rope.split(20);
+    rope.insert(Rope('Y'), 8);
+
+    ASSERT_EQ(left.asString(), (SHORT_STR_1.substr(0, 7) + "X" + SHORT_STR_1.substr(7)).substr(0, 20));
+    ASSERT_EQ(rope.asString(), SHORT_STR_1.substr(0, 7) + "XY" + SHORT_STR_1.substr(7));
+}
+
+static int treeDepth(const RopeNodePtr& node)
+{
+    if (node == nullptr)
+        return 0;
+
+    return 1 + std::max(treeDepth(node->lChild), treeDepth(node->rChild));
+}
+
+TEST(RopeFinger, TypingKeepsTreeShallow)
+{
+    std::string expected = LOREM + LOREM;
+    Rope rope(expected);
+
+    for (int i = 0; i < 5000; i++)
+    {
+        char c = 'a' + i % 26;
+
+        rope.insert(Rope(c), 100 + i);
+        expected.insert(100 + i, 1, c);
+    }
+
+    ASSERT_EQ(rope.asString(), expected);
+    ASSERT_EQ(rope.newlineCount(), 0);
+    ASSERT_LE(treeDepth(rope.rootNode()), 2 * std::log2(expected.length()) + 2);
+
+    for (int i = 0; i < expected.length(); i += 13)
+        ASSERT_EQ(rope.at(i), expected[i]);
+}
+
+TEST(RopeFinger, TypingWithBackspaceKeepsTreeShallow)
+{
+    std::string expected = LOREM + LOREM;
+    Rope rope(expected);
+    int cursor = 100;
+
+    for (int i = 0; i < 5000; i++)
+    {
+        if (i % 3 == 2 || (i % 50 >= 40 && cursor > 0))
+        {
+            rope.erase(cursor - 1, cursor);
+            expected.erase(cursor - 1, 1);
+            cursor--;
+        }
+        else
+        {
+            char c = i % 11 == 0 ? '\n' : 'a' + i % 26;
+
+            rope.insert(Rope(c), cursor);
+            expected.insert(cursor, 1, c);
+            cursor++;
+        }
+    }
+
+    for (int i = 0; i < 300; i++)
+    {
+        rope.erase(cursor - 1, cursor);
+        expected.erase(cursor - 1, 1);
+        cursor--;
+    }
+
+    ASSERT_EQ(rope.asString(), expected);
+    ASSERT_EQ(rope.length(), expected.length());
+    ASSERT_EQ(rope.newlineCount(), std::count(expected.begin(), expected.end(), '\n'));
+    ASSERT_LE(treeDepth(rope.rootNode()), 2 * std::log2(expected.length()) + 2);
+
+    for (int i = 0; i < expected.length(); i += 7)
+        ASSERT_EQ(rope.at(i), expected[i]);
+}
+
+TEST(RopeFinger, EraseEverything)
+{
+    Rope rope(SHORT_STR_1);
+
+    for (int i = SHORT_STR_1.length(); i > 0; i--)
+        rope.erase(i - 1, i);
+
+    ASSERT_EQ(rope.length(), 0);
+    ASSERT_EQ(rope.rootNode(), nullptr);
+
+    rope.insert(Rope('x'), 0);
+    ASSERT_EQ(rope.asString(), "x");
+}
+
+TEST(RopeFinger, ShortErasesAcrossLeaves)
+{
+    std::string expected = LOREM;
+    Rope rope(LOREM);
+
+    for (int i = 0; i < 40; i++)
+    {
+        int start = (i * 37) % (expected.length() - 20);
+        int length = 1 + i % 20;
+
+        rope.erase(start, start + length);
+        expected.erase(start, length);
+
+        ASSERT_EQ(rope.length(), expected.length());
+    }
+
+    ASSERT_EQ(rope.asString(), expected);
+    ASSERT_EQ(rope.newlineCount(), 0);
+}
+
+TEST(RopeFinger, EraseLeavesCopiesAlone)
+{
+    Rope rope(SHORT_STR_1);
+    rope.erase(10, 11);
+
+    Rope copy(rope);
+    rope.erase(9, 10);
+
+    ASSERT_EQ(copy.asString(), SHORT_STR_1.substr(0, 10) + SHORT_STR_1.substr(11));
+    ASSERT_EQ(rope.asString(), SHORT_STR_1.substr(0, 9) + SHORT_STR_1.substr(11));
+}
+
+TEST(RopeFinger, ReadsDoNotMoveFinger)
+{
+    Rope rope(LOREM);
+    const Rope& view = rope;
+
+    for (int i = 0; i < LOREM.length(); i++)
+        ASSERT_EQ(view.at(i), LOREM[i]);
+
+    rope.insert(Rope('X'), 40);
+    ASSERT_EQ(view.at(40), 'X');
+    ASSERT_EQ(view.at(LOREM.length()), LOREM.back());
+}
+
+TEST(RopeScan, Count)
+{
+    Rope rope(LOREM);
+
+    ASSERT_EQ(rope.count('a'), std::count(LOREM.begin(), LOREM.end(), 'a'));
+    ASSERT_EQ(rope.count('#'), 0);
+}
+
+TEST(RopeScan, Find)
+{
+    Rope rope(LOREM);
+
+    ASSERT_EQ(rope.find('.'), LOREM.find('.'));
+    ASSERT_EQ(rope.find('.', 100), LOREM.find('.', 100));
+    ASSERT_EQ(rope.find('#'), -1);
+    ASSERT_EQ(rope.findLast('.'), LOREM.rfind('.'));
+    ASSERT_EQ(rope.findLast('#'), -1);
+}
+
+TEST(RopeScan, NewlineCountAfterEdits)
+{
+    Rope rope("one\ntwo\nthree\n");
+
+    rope.insert(Rope("\nfour\n"), 5);
+    ASSERT_EQ(rope.newlineCount(), 5);
+
+    rope.insert(Rope('\n'), 6);
+    ASSERT_EQ(rope.newlineCount(), 6);
+
+    rope.erase(0, 6);
+    ASSERT_EQ(rope.newlineCount(), 4);
+    ASSERT_EQ(rope.count('\n'), 4);
+}
+
+TEST(RopeScan, NewlineCountOnConstruction)
+{
+    std::string text;
+
+    for (int i = 0; i < 200; i++)
+        text += std::string(i % 7, 'x') + (i % 3 == 0 ? "\n\n" : "\n");
+
+    Rope rope(text);
+
+    ASSERT_EQ(rope.newlineCount(), std::count(text.begin(), text.end(), '\n'));
+
+    for (int i = 0; i <= text.length(); i += 37)
+    {
+        auto [left, right] = rope.split(i);
+        ASSERT_EQ(left.newlineCount(), std::count(text.begin(), text.begin() + i, '\n'));
+    }
+}
+
+TEST(RopeScan, Utf8Length)
+{
+    Rope rope("r\xc3\xa4ksm\xc3\xb6rg\xc3\xa5s \xe2\x82\xac");
+
+    ASSERT_EQ(rope.utf8Length(), 12);
+}
+
+static std::string readFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& path, const std::string& content)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << content;
+}
+
+// Rewrites the file in place and restores its modification time, so that a
+// rope cannot tell that it changed.
+static void writeFileUnnoticed(const std::string& path, const std::string& content)
+{
+    struct stat status;
+    stat(path.c_str(), &status);
+
+    writeFile(path, content);
+
+    timespec times[2] = {status.st_atim, status.st_mtim};
+    utimensat(AT_FDCWD, path.c_str(), times, 0);
+}
+
+TEST(RopeSave, FullSave)
+{
+    std::string path = testing::TempDir() + "rope_full_save.txt";
+    writeFile(path, std::string(5000, 'x'));
+
+    Rope rope(LOREM);
+    rope.save(path);
+
+    ASSERT_EQ(readFile(path), LOREM);
+    ASSERT_TRUE(rope.dirtyRanges().empty());
+}
+
+TEST(RopeSave, DirtyRanges)
+{
+    Rope rope(SHORT_STR_1);
+    rope.markSaved("unused");
+
+    rope.concat(Rope("!"));
+    ASSERT_EQ(rope.dirtyRanges(), (std::vector<std::pair<int, int>>{{52, 53}}));
+
+    rope.insert(Rope("abc"), 10);
+    ASSERT_EQ(rope.dirtyRanges(), (std::vector<std::pair<int, int>>{{10, 56}}));
+
+    rope.erase(2, 4);
+    ASSERT_EQ(rope.dirtyRanges(), (std::vector<std::pair<int, int>>{{2, 54}}));
+}
+
+TEST(RopeSave, IncrementalSaveOnlyWritesChanges)
+{
+    std::string path = testing::TempDir() + "rope_incremental_save.txt";
+
+    Rope rope(LOREM);
+    rope.save(path);
+
+    // Changed behind the rope's back; untouched by an incremental save.
+    std::string onDisk = LOREM;
+    onDisk[0] = '#';
+    writeFileUnnoticed(path, onDisk);
+
+    rope.insert(Rope("inserted"), 100);
+    rope.erase(500, 510);
+    rope.save(path);
+
+    std::string expected = rope.asString();
+    expected[0] = '#';
+
+    ASSERT_EQ(readFile(path), expected);
+
+    rope.save(path + ".copy");
+
+    ASSERT_EQ(readFile(path + ".copy"), rope.asString());
+}
+
+TEST(RopeSave, Truncates)
+{
+    std::string path = testing::TempDir() + "rope_truncate_save.txt";
+
+    Rope rope(LOREM);
+    rope.save(path);
+
+    rope.erase(10, LOREM.length());
+    rope.save(path);
+
+    ASSERT_EQ(readFile(path), LOREM.substr(0, 10));
+}
+
+TEST(RopeSave, FileDeletedBetweenSaves)
+{
+    std::string path = testing::TempDir() + "rope_deleted_save.txt";
+
+    Rope rope(SHORT_STR_1);
+    rope.save(path);
+
+    std::remove(path.c_str());
+
+    rope.append("!");
+    rope.save(path);
+
+    ASSERT_EQ(readFile(path), SHORT_STR_1 + "!");
+}
+
+TEST(RopeSave, FileReplacedBetweenSaves)
+{
+    std::string path = testing::TempDir() + "rope_replaced_save.txt";
+    std::string other = path + ".other";
+
+    Rope rope(SHORT_STR_1);
+    rope.save(path);
+
+    writeFile(other, std::string(SHORT_STR_1.length(), '#'));
+    std::rename(other.c_str(), path.c_str());
+
+    rope.insert(Rope("abc"), 5);
+    rope.save(path);
+
+    ASSERT_EQ(readFile(path), rope.asString());
+}
+
+TEST(RopeSave, FileModifiedBetweenSaves)
+{
+    std::string path = testing::TempDir() + "rope_modified_save.txt";
+
+    Rope rope(SHORT_STR_1);
+    rope.save(path);
+
+    writeFile(path, std::string(SHORT_STR_1.length(), '#'));
+
+    timespec times[2] = {{0, UTIME_OMIT}, {1, 0}};
+    utimensat(AT_FDCWD, path.c_str(), times, 0);
+
+    rope.insert(Rope("abc"), 5);
+    rope.save(path);
+
+    ASSERT_EQ(readFile(path), rope.asString());
+}
+
+TEST(RopeSave, SaveRevertedCopy)
+{
+    std::string path = testing::TempDir() + "rope_revert_save.txt";
+
+    Rope doc(LOREM);
+    doc.save(path);
+
+    Rope backup = doc;
+    doc.insert(Rope("XXXX"), 0);
+    doc.save(path);
+
+    ASSERT_TRUE(backup.dirtyRanges().empty());
+
+    backup.save(path);
+    ASSERT_EQ(readFile(path), LOREM);
+
+    doc = backup;
+    doc.insert(Rope("YY"), 3);
+    doc.save(path);
+    ASSERT_EQ(readFile(path), LOREM.substr(0, 3) + "YY" + LOREM.substr(3));
+}
+
+TEST(RopeSave, MoveKeepsSavedFile)
+{
+    std::string path = testing::TempDir() + "rope_move_save.txt";
+
+    Rope rope(LOREM);
+    rope.save(path);
+    rope.insert(Rope("abc"), 10);
+
+    Rope moved = std::move(rope);
+
+    ASSERT_EQ(moved.dirtyRanges(), (std::vector<std::pair<int, int>>{{10, int(LOREM.length()) + 3}}));
+
+    moved.save(path);
+    ASSERT_EQ(readFile(path), moved.asString());
+}
+
+TEST(RopeDelta, ObserverSeesEveryEdit)
+{
+    Rope rope(SHORT_STR_1);
+    std::vector<RopeDelta> seen;
+
+    int id = rope.addObserver([&](const RopeDelta& delta) { seen.push_back(delta); });
+
+    rope.insert(Rope("abc"), 10);
+    rope.erase(0, 4);
+    rope.concat(Rope("!"));
+
+    Rope copy(rope);
+    copy.erase(0, 1);
+
+    rope.removeObserver(id);
+    rope.erase(0, 1);
+
+    ASSERT_EQ(seen, (std::vector<RopeDelta>{{10, 0, 3}, {0, 4, 0}, {51, 0, 1}}));
+}
+
+TEST(RopeDelta, LogMergesTyping)
+{
+    Rope rope(SHORT_STR_1);
+    rope.setDeltaLogging(true);
+
+    for (int i = 0; i < 6; i++)
+        rope.insert(Rope('x'), 20 + i);
+
+    rope.erase(25, 26);
+    rope.erase(24, 25);
+
+    ASSERT_EQ(rope.takeDeltas(), (std::vector<RopeDelta>{{20, 0, 4}}));
+    ASSERT_TRUE(rope.takeDeltas().empty());
+}
+
+TEST(RopeDelta, LogKeepsSeparateEdits)
+{
+    Rope rope(SHORT_STR_1);
+    rope.setDeltaLogging(true);
+
+    rope.insert(Rope('x'), 5);
+    rope.insert(Rope('y'), 30);
+    rope.erase(10, 12);
+
+    ASSERT_EQ(rope.takeDeltas(), (std::vector<RopeDelta>{{5, 0, 1}, {30, 0, 1}, {10, 2, 0}}));
+}
+
+TEST(RopeDelta, LogMergesBackspace)
+{
+    Rope rope(SHORT_STR_1);
+    rope.setDeltaLogging(true);
+
+    for (int i = 20; i > 15; i--)
+        rope.erase(i - 1, i);
+
+    ASSERT_EQ(rope.takeDeltas(), (std::vector<RopeDelta>{{15, 5, 0}}));
+}
+
+TEST(RopeDelta, TransformOffsets)
+{
+    std::vector<RopeDelta> deltas = {{10, 0, 3}, {0, 4, 0}};
+
+    ASSERT_EQ(RopeDelta::transform(2, deltas), 0);
+    ASSERT_EQ(RopeDelta::transform(5, deltas), 1);
+    ASSERT_EQ(RopeDelta::transform(10, deltas), 6);
+    ASSERT_EQ(RopeDelta::transform(10, deltas, true), 9);
+    ASSERT_EQ(RopeDelta::transform(20, deltas), 19);
+
+    Rope rope(SHORT_STR_1);
+    Rope edited(rope);
+
+    for (const auto& delta : deltas)
+    {
+        edited.erase(delta.offset, delta.offset + delta.removed);
+        edited.insert(Rope(std::string(delta.inserted, '_')), delta.offset);
+    }
+
+    ASSERT_EQ(edited.at(RopeDelta::transform(20, deltas)), rope.at(20));
+}
+
+static bool containsNode(const RopeNodePtr& node, const RopeNode* target)
+{
+    if (node == nullptr)
+        return false;
+
+    return node.get() == target || containsNode(node->lChild, target) || containsNode(node->rChild, target);
+}
+
+static const RopeNode* leafAt(RopeNodePtr node, int index)
+{
+    while (!node->isLeaf())
+    {
+        if (index < node->weight)
+            node = node->lChild;
+        else
+        {
+            index -= node->weight;
+            node = node->rChild;
+        }
+    }
+
+    return node.get();
+}
+
+TEST(RopeMove, ConcatAdoptsLeaves)
+{
+    Rope rope(SHORT_STR_1);
+    Rope other(SHORT_STR_2);
+
+    const RopeNode* leaf = leafAt(other.rootNode(), 20);
+    rope.concat(std::move(other));
+
+    ASSERT_EQ(rope.asString(), SHORT_STR_1 + SHORT_STR_2);
+    ASSERT_TRUE(containsNode(rope.rootNode(), leaf));
+    ASSERT_EQ(other.rootNode(), nullptr);
+}
+
+TEST(RopeMove, InsertAdoptsLeaves)
+{
+    Rope rope(SHORT_STR_1);
+    Rope other(SHORT_STR_2);
+
+    const RopeNode* leaf = leafAt(other.rootNode(), 20);
+    rope.insert(std::move(other), 10);
+
+    ASSERT_EQ(rope.asString(), SHORT_STR_1.substr(0, 10) + SHORT_STR_2 + SHORT_STR_1.substr(10));
+    ASSERT_TRUE(containsNode(rope.rootNode(), leaf));
+}
+
+TEST(RopeMove, SelfInsert)
+{
+    Rope rope(SHORT_STR_1);
+    rope.insert(std::move(rope), 10);
+
+    ASSERT_EQ(rope.asString(), SHORT_STR_1.substr(0, 10) + SHORT_STR_1 + SHORT_STR_1.substr(10));
+
+    Rope small("abc");
+    small.insert(std::move(small), 1);
+
+    ASSERT_EQ(small.asString(), "aabcbc");
+}
+
+TEST(RopeMove, ConsumingSplitReusesNodes)
+{
+    Rope rope(LOREM);
+
+    const RopeNode* leaf = leafAt(rope.rootNode(), 7);
+    auto [left, right] = std::move(rope).split(7);
+
+    ASSERT_EQ(left.asString(), LOREM.substr(0, 7));
+    ASSERT_EQ(right.asString(), LOREM.substr(7));
+    ASSERT_EQ(rope.rootNode(), nullptr);
+    ASSERT_EQ(leafAt(left.rootNode(), 6), leaf);
+}
+
+TEST(RopeMove, ConsumingSplitLeavesCopiesAlone)
+{
+    Rope rope(LOREM);
+    Rope copy(rope);
+
+    auto [left, right] = std::move(rope).split(7);
+
+    ASSERT_EQ(left.asString(), LOREM.substr(0, 7));
+    ASSERT_EQ(right.asString(), LOREM.substr(7));
+    ASSERT_EQ(copy.asString(), LOREM);
+}
+
+TEST(RopeMove, EditReusesOwnedLeaves)
+{
+    Rope rope(LOREM);
+
+    const RopeNode* leaf = leafAt(rope.rootNode(), 7);
+    rope.erase(7, 60);
+
+    ASSERT_EQ(rope.asString(), LOREM.substr(0, 7) + LOREM.substr(60));
+    ASSERT_EQ(leafAt(rope.rootNode(), 6), leaf);
+
+    Rope other(LOREM);
+
+    leaf = leafAt(other.rootNode(), 32);
+    other.insert(Rope(SHORT_STR_2), 32);
+
+    ASSERT_EQ(other.asString(), LOREM.substr(0, 32) + SHORT_STR_2 + LOREM.substr(32));
+    ASSERT_EQ(leafAt(other.rootNode(), 31), leaf);
+}
+
+TEST(RopeMove, EditLeavesCopiesAlone)
+{
+    Rope rope(LOREM);
+    Rope copy(rope);
+
+    rope.erase(7, 20);
+    rope.insert(Rope(SHORT_STR_2), 32);
+
+    ASSERT_EQ(copy.asString(), LOREM);
+    ASSERT_EQ(copy.rootNode()->newlines, 0);
+}
+
+TEST(RopeMove, AppendPrepend)
+{
+    Rope rope("middle");
+    std::string tail = " end";
+    std::string_view head = "start ";
+
+    rope.append(std::move(tail));
+    rope.append(std::string(" and more"));
+    rope.append("!");
+    rope.prepend(head);
+    rope.prepend(std::string(">> "));
+
+    ASSERT_EQ(rope.asString(), ">> start middle end and more!");
+}
+
+TEST(RopeCompare, EqualContentDifferentLeaves)
+{
+    Rope rope(SHORT_STR_1);
+    Rope built("");
+
+    for (const char& c : SHORT_STR_1)
+        built.insert(Rope(c), built.length());
+
+    ASSERT_FALSE(rope.sameStructure(built));
+    ASSERT_EQ(rope, built);
+    ASSERT_EQ(rope.compare(built), 0);
+}
+
+TEST(RopeCompare, Ordering)
+{
+    std::vector<std::string> strings = {"", "a", "ab", "abc", "abd", "b", SHORT_STR_1, SHORT_STR_2, LOREM, LOREM + "!", "\xff"};
+
+    for (const auto& a : strings)
+        for (const auto& b : strings)
+        {
+            Rope left(a);
+            Rope right = Rope(b.substr(0, 3));
+            right.concat(Rope(b.size() > 3 ? b.substr(3) : ""));
+
+            int expected = a.compare(b);
+            int order = left.compare(right);
+
+            ASSERT_EQ(order < 0, expected < 0) << a << " vs " << b;
+            ASSERT_EQ(order > 0, expected > 0) << a << " vs " << b;
+            ASSERT_EQ(left < right, a < b);
+            ASSERT_EQ(left <= right, a <= b);
+            ASSERT_EQ(left > right, a > b);
+            ASSERT_EQ(left >= right, a >= b);
+            ASSERT_EQ(left == right, a == b);
+            ASSERT_EQ(left != right, a != b);
+        }
+}
+
+TEST(RopeCompare, CommonPrefixLength)
+{
+    Rope rope(LOREM);
+
+    ASSERT_EQ(rope.commonPrefixLength(Rope(LOREM.substr(0, 100) + "#")), 100);
+    ASSERT_EQ(rope.commonPrefixLength(rope), LOREM.length());
+    ASSERT_EQ(rope.commonPrefixLength(Rope("")), 0);
+}
+
+TEST(RopeCompare, StartsEndsWith)
+{
+    Rope rope(LOREM);
+
+    ASSERT_TRUE(rope.startsWith(Rope(LOREM.substr(0, 123))));
+    ASSERT_TRUE(rope.startsWith(Rope("")));
+    ASSERT_FALSE(rope.startsWith(Rope("Ipsum")));
+    ASSERT_FALSE(rope.startsWith(Rope(LOREM + "x")));
+
+    for (int length : {0, 1, 4, 5, 6, 77, 500})
+        ASSERT_TRUE(rope.endsWith(Rope(LOREM.substr(LOREM.length() - length)))) << length;
+
+    ASSERT_FALSE(rope.endsWith(Rope("viverra.")));
+    ASSERT_FALSE(Rope("abc").endsWith(Rope("xabc")));
+}
+
+TEST(RopeCompare, SortWithoutFlattening)
+{
+    std::vector<std::string> strings = {"pear", "apple", "fig", "banana", "apple pie", "cherry"};
+    std::vector<Rope> ropes(strings.begin(), strings.end());
+
+    std::sort(strings.begin(), strings.end());
+    std::sort(ropes.begin(), ropes.end());
+
+    for (int i = 0; i < strings.size(); i++)
+        ASSERT_EQ(ropes[i].asString(), strings[i]);
+}
+
+TEST(LocalRope, EditsMatchString)
+{
+    std::mt19937 rng(7);
+    std::string expected = LOREM;
+    LocalRope rope(LOREM);
+
+    for (int i = 0; i < 300; i++)
+    {
+        int pos = rng() % (expected.length() + 1);
+
+        if (rng() % 3 != 0)
+        {
+            std::string piece = SHORT_STR_2.substr(0, rng() % 12);
+
+            rope.insert(LocalRope(piece), pos);
+            expected.insert(pos, piece);
+        }
+        else
+        {
+            int end = std::min<int>(expected.length(), pos + rng() % 40);
+
+            rope.erase(pos, end);
+            expected.erase(pos, end - pos);
+        }
+    }
+
+    ASSERT_EQ(rope.asString(), expected);
+    ASSERT_EQ(rope, LocalRope(expected));
+}
+
+TEST(LocalRope, CopiesShareNodes)
+{
+    LocalRope rope(LOREM);
+    LocalRope copy(rope);
+
+    ASSERT_EQ(rope.rootNode(), copy.rootNode());
+
+    copy.insert(LocalRope('X'), 10);
+
+    ASSERT_EQ(rope.asString(), LOREM);
+    ASSERT_EQ(copy.asString(), LOREM.substr(0, 10) + "X" + LOREM.substr(10));
+}